@@ -0,0 +1,265 @@
+// 任意精度的非负整数，以10^9为基，低位在前，便于直接按十进制输出
+// 乘法在较短的一方不少于KARATSUBA_MIN位时用Karatsuba，阶乘的二分乘积因此比逐个相乘快
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIG_BASE 1000000000u
+#define KARATSUBA_MIN 32
+
+struct bigint {
+    uint32_t len;    // 有效位数，0表示0，最高位不为0
+    uint32_t cap;
+    uint32_t *d;
+};
+
+static inline void *big_alloc(size_t n) {
+    void *p = malloc(n ? n : 1);
+    if (!p) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static inline void big_reserve(struct bigint *b, size_t cap) {
+    if (cap <= b->cap) return;
+    b->d = realloc(b->d, cap * sizeof(uint32_t));
+    if (!b->d) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    b->cap = cap;
+}
+
+static inline void big_free(struct bigint *b) {
+    free(b->d);
+    *b = (struct bigint) { 0 };
+}
+
+static inline void big_trim(struct bigint *b) {
+    while (b->len > 0 && b->d[b->len - 1] == 0) b->len--;
+}
+
+static inline void big_set(struct bigint *b, uint64_t v) {
+    big_reserve(b, 3);
+    for (b->len = 0; v; v /= BIG_BASE) b->d[b->len++] = v % BIG_BASE;
+}
+
+static inline void big_copy(struct bigint *r, const struct bigint *a) {
+    big_reserve(r, a->len);
+    if (a->len) memcpy(r->d, a->d, a->len * sizeof(uint32_t));
+    r->len = a->len;
+}
+
+// a[0..an) += b[0..bn)，an > bn，进位不会超出a
+static inline void add_into(uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+    uint32_t carry = 0;
+    size_t i = 0;
+    for (; i < bn; i++) {
+        uint32_t t = a[i] + b[i] + carry;
+        carry = t >= BIG_BASE;
+        a[i] = carry ? t - BIG_BASE : t;
+    }
+    for (; carry && i < an; i++) {
+        carry = ++a[i] == BIG_BASE;
+        if (carry) a[i] = 0;
+    }
+}
+
+// a[0..an) -= b[0..bn)，要求a >= b
+static inline void sub_from(uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+    uint32_t borrow = 0;
+    size_t i = 0;
+    for (; i < bn; i++) {
+        uint32_t s = b[i] + borrow;
+        borrow = a[i] < s;
+        a[i] = borrow ? a[i] + BIG_BASE - s : a[i] - s;
+    }
+    for (; borrow && i < an; i++) {
+        borrow = a[i] == 0;
+        a[i] = borrow ? BIG_BASE - 1 : a[i] - 1;
+    }
+}
+
+static inline void mul_school(uint32_t *out, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+    memset(out, 0, (an + bn) * sizeof(uint32_t));
+    for (size_t i = 0; i < an; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < bn; j++) {
+            uint64_t t = out[i + j] + (uint64_t)a[i] * b[j] + carry;
+            out[i + j] = t % BIG_BASE;
+            carry = t / BIG_BASE;
+        }
+        out[i + bn] = carry;
+    }
+}
+
+// out[0..an+bn) = a * b，out不能与a、b重叠
+static void mul_raw(uint32_t *out, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+    if (an < bn) {
+        const uint32_t *t = a;
+        a = b, b = t;
+        size_t tn = an;
+        an = bn, bn = tn;
+    }
+    if (bn < KARATSUBA_MIN) {
+        mul_school(out, a, an, b, bn);
+        return;
+    }
+    size_t m = an / 2;
+    if (bn <= m) {
+        // b太短，只拆a：a1*b*B^m + a0*b
+        uint32_t *hi = big_alloc((an - m + bn) * sizeof(uint32_t));
+        mul_raw(out, a, m, b, bn);
+        memset(out + m + bn, 0, (an - m) * sizeof(uint32_t));
+        mul_raw(hi, a + m, an - m, b, bn);
+        add_into(out + m, an, hi, an - m + bn);
+        free(hi);
+        return;
+    }
+    // z0 = a0*b0放在低2m位，z2 = a1*b1放在高位，z1 = (a0+a1)(b0+b1) - z0 - z2 加在第m位
+    size_t an1 = an - m, bn1 = bn - m, sn = an1 + 1;
+    mul_raw(out, a, m, b, m);
+    mul_raw(out + 2 * m, a + m, an1, b + m, bn1);
+    uint32_t *sa = big_alloc(sn * sizeof(uint32_t)), *sb = big_alloc(sn * sizeof(uint32_t));
+    uint32_t *z1 = big_alloc(2 * sn * sizeof(uint32_t));
+    memcpy(sa, a + m, an1 * sizeof(uint32_t));
+    sa[an1] = 0;
+    add_into(sa, sn, a, m);
+    memset(sb, 0, sn * sizeof(uint32_t));
+    memcpy(sb, b + m, bn1 * sizeof(uint32_t));
+    add_into(sb, sn, b, m);
+    mul_raw(z1, sa, sn, sb, sn);
+    sub_from(z1, 2 * sn, out, 2 * m);
+    sub_from(z1, 2 * sn, out + 2 * m, an1 + bn1);
+    // z1不超过an+bn-m位，多出来的高位都是0
+    add_into(out + m, an + bn - m, z1, an + bn - m < 2 * sn ? an + bn - m : 2 * sn);
+    free(sa);
+    free(sb);
+    free(z1);
+}
+
+// r = a * b，r可以与a或b相同
+static inline void big_mul(struct bigint *r, const struct bigint *a, const struct bigint *b) {
+    if (a->len == 0 || b->len == 0) {
+        r->len = 0;
+        return;
+    }
+    size_t n = a->len + b->len;
+    uint32_t *out = big_alloc(n * sizeof(uint32_t));
+    mul_raw(out, a->d, a->len, b->d, b->len);
+    free(r->d);
+    *r = (struct bigint) { n, n, out };
+    big_trim(r);
+}
+
+static inline void big_mul_small(struct bigint *b, uint32_t m) {
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < b->len; i++) {
+        uint64_t t = (uint64_t)b->d[i] * m + carry;
+        b->d[i] = t % BIG_BASE;
+        carry = t / BIG_BASE;
+    }
+    big_reserve(b, b->len + 2);
+    for (; carry; carry /= BIG_BASE) b->d[b->len++] = carry % BIG_BASE;
+    big_trim(b);
+}
+
+// r = a + b，r可以与a或b相同。同一位上先读后写，所以a、b、r都相同时也能原地相加
+static inline void big_add(struct bigint *r, const struct bigint *a, const struct bigint *b) {
+    if (r == b) {
+        const struct bigint *t = a;
+        a = b, b = t;
+    }
+    uint32_t an = a->len, bn = b->len, n = (an > bn ? an : bn) + 1;
+    big_reserve(r, n);
+    if (r != a && an) memcpy(r->d, a->d, an * sizeof(uint32_t));   // 零的d可能是NULL
+    memset(r->d + an, 0, (n - an) * sizeof(uint32_t));
+    r->len = n;
+    add_into(r->d, n, b->d, bn);
+    big_trim(r);
+}
+
+// a -= b，要求a >= b
+static inline void big_sub(struct bigint *a, const struct bigint *b) {
+    sub_from(a->d, a->len, b->d, b->len);
+    big_trim(a);
+}
+
+static inline void big_print(FILE *out, const struct bigint *b) {
+    if (b->len == 0) {
+        fputc('0', out);
+        return;
+    }
+    fprintf(out, "%u", b->d[b->len - 1]);
+    for (uint32_t i = b->len - 1; i-- > 0;) fprintf(out, "%09u", b->d[i]);
+}
+
+// 快速倍增：F(2k) = F(k)(2F(k+1) - F(k))，F(2k+1) = F(k)^2 + F(k+1)^2，O(log n)次大数乘法
+// 与fibonacci()一致，n为0时结果为1
+static inline void big_fibonacci(struct bigint *r, unsigned n) {
+    if (n == 0) {
+        big_set(r, 1);
+        return;
+    }
+    struct bigint a = { 0 }, b = { 0 }, c = { 0 }, d = { 0 }, t = { 0 };
+    big_set(&a, 0);
+    big_set(&b, 1);
+    for (int bit = 31 - __builtin_clz(n); bit >= 0; bit--) {
+        big_add(&t, &b, &b);
+        big_sub(&t, &a);
+        big_mul(&c, &a, &t);      // F(2k)
+        big_mul(&d, &a, &a);
+        big_mul(&t, &b, &b);
+        big_add(&d, &d, &t);      // F(2k+1)
+        if (n >> bit & 1) {
+            big_add(&b, &c, &d);
+            big_copy(&a, &d);
+        } else {
+            big_copy(&a, &c);
+            big_copy(&b, &d);
+        }
+    }
+    big_copy(r, &a);
+    big_free(&a);
+    big_free(&b);
+    big_free(&c);
+    big_free(&d);
+    big_free(&t);
+}
+
+// lo..hi的乘积：区间短时把相邻的数先在64位里乘起来再乘进大数，否则二分后两半相乘，
+// 两半的位数相近，正好让Karatsuba发挥作用
+static void product_range(struct bigint *r, uint64_t lo, uint64_t hi) {
+    if (hi - lo < 64) {
+        big_set(r, 1);
+        uint64_t w = 1;
+        for (uint64_t i = lo; i <= hi; i++) {
+            if (w * i >= BIG_BASE) {
+                big_mul_small(r, w);
+                w = 1;
+            }
+            w *= i;
+        }
+        big_mul_small(r, w);
+        return;
+    }
+    uint64_t mid = lo + (hi - lo) / 2;
+    struct bigint right = { 0 };
+    product_range(r, lo, mid);
+    product_range(&right, mid + 1, hi);
+    big_mul(r, r, &right);
+    big_free(&right);
+}
+
+static inline void big_factorial(struct bigint *r, unsigned n) {
+    if (n < 2) big_set(r, 1);
+    else product_range(r, 2, n);
+}
+
+#endif
@@ -1,9 +1,20 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 
+#include "shm_ring.h"
+#include "bigint.h"
+
 // 定义关闭管道端的宏
 #define CLOSE_PIPE_END(pipe, end) do { \
     if (close(pipe[end]) == -1) { \
@@ -12,15 +23,23 @@
     } \
 } while(0)
 
-#define CLOSE_ALL_PIPES() do { \
-    CLOSE_PIPE_END(x_pipe, 0); CLOSE_PIPE_END(x_pipe, 1); \
-    CLOSE_PIPE_END(y_pipe, 0); CLOSE_PIPE_END(y_pipe, 1); \
-} while(0)
+// 批量协议：每帧是一个帧头加count个值，请求帧里是输入，结果帧里是对应的结果，顺序不变。
+// 结果帧沿用请求帧的编号，父进程按编号找回这批结果属于哪个函数、哪些输入，
+// 所以所有子进程可以共用一个结果管道。
+// 一帧不超过PIPE_BUF字节，对管道的一次write是原子的，多个子进程写的帧不会交错。
+// 大数结果放不进一帧时拆成多帧，除最后一帧外都带FRAME_MORE，同一请求的帧总是按顺序到达
+struct frame {
+    uint32_t id;     // 请求编号
+    uint32_t count;  // 帧头后面的值个数
+    uint32_t flags;
+};
+#define FRAME_MORE 1
+#define MAX_BATCH ((PIPE_BUF - sizeof(struct frame)) / sizeof(unsigned))
 
-// 全局管道
-int x_pipe[2];  // x管道
-int y_pipe[2];  // y管道
-int res_pipe[2];// 结果管道(加法可以交换，所以不关注xy的顺序，可以复用结果管道)
+#define NFUNC 2       // f(x)和f(y)
+#define MAX_WORKERS 64
+
+int nworker = 1;       // 每个函数的子进程数
 
 // 阶乘
 unsigned factorial(unsigned n) {
@@ -43,122 +62,898 @@ unsigned fibonacci(unsigned n) {
     return b;
 }
 
-// 子进程（实现函数复用）
-void child_process(int read_pipe, int write_pipe, unsigned (*calc_func)(unsigned)) {
-    // 关闭不需要的管道端
-    if (read_pipe == x_pipe[0]) CLOSE_PIPE_END(y_pipe, 0);   // 关闭x_pipe的写端
-    else CLOSE_PIPE_END(x_pipe, 0);  // 关闭y_pipe的写端
-    CLOSE_PIPE_END(x_pipe, 1);
-    CLOSE_PIPE_END(y_pipe, 1);
-    CLOSE_PIPE_END(res_pipe, 0);  // 关闭res_pipe的读端
+unsigned (*const funcs[NFUNC])(unsigned) = { factorial, fibonacci };
+const char *const func_names[NFUNC] = { "factorial", "fibonacci" };
+
+// 计算用的内核：word为上面的unsigned版本（会溢出），big为bigint.h里的任意精度版本，
+// 结果按 位数, 各位... 依次编码在结果帧里
+enum { KERNEL_WORD, KERNEL_BIG };
+int kernel = KERNEL_WORD;
+void (*const big_funcs[NFUNC])(struct bigint *, unsigned) = { big_factorial, big_fibonacci };
 
-    unsigned input;
-    while (1) {
-        ssize_t bytes = read(read_pipe, &input, sizeof(input));
+// 读满len字节，对端关闭时返回0，否则返回1
+int read_full(int fd, void *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t bytes = read(fd, (char *)buf + done, len - done);
+        if (bytes == 0 && done == 0) return 0;
         if (bytes <= 0) {
-            if (bytes == 0) break;  // 正常结束
+            if (bytes == -1 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (bytes == 0) errno = EPIPE;  // 帧不完整
             perror("read");
             exit(EXIT_FAILURE);
         }
-        
-        unsigned result = calc_func(input);
-        if (write(write_pipe, &result, sizeof(result)) == -1) {
-            perror("write");
-            exit(EXIT_FAILURE);
+        done += bytes;
+    }
+    return 1;
+}
+
+// 把帧头和值拼起来，一次write写出整帧；非阻塞的fd写不下时返回0
+int write_frame(int fd, const struct frame *hdr, const unsigned *values) {
+    char buf[PIPE_BUF];
+    size_t len = sizeof(*hdr) + hdr->count * sizeof(unsigned);
+    memcpy(buf, hdr, sizeof(*hdr));
+    memcpy(buf + sizeof(*hdr), values, hdr->count * sizeof(unsigned));
+    ssize_t bytes = write(fd, buf, len);
+    if (bytes == -1 && errno == EAGAIN) return 0;
+    if (bytes != (ssize_t)len) {
+        perror("write");
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+size_t frame_body_len(const void *hdr) {
+    return ((const struct frame *)hdr)->count * sizeof(unsigned);
+}
+
+// 父子进程之间的传输方式。子进程一侧是阻塞的收发；父进程一侧是非阻塞的收发，
+// 都做不了时调用wait()，等到want[f]号子进程可写（-1表示f不需要发送）或有结果可读
+struct transport {
+    const char *name;
+    void (*setup)(void);                 // fork之前
+    void (*child_init)(int f, int w);    // fork之后的子进程里
+    void (*parent_init)(void);           // 所有子进程创建之后的父进程里
+    int (*child_recv)(int f, int w, struct frame *hdr, unsigned *values);  // 输入结束返回0
+    void (*child_send)(int f, int w, const struct frame *hdr, const unsigned *values);
+    int (*try_send)(int f, int w, const struct frame *hdr, const unsigned *values);
+    int (*try_recv)(struct frame *hdr, unsigned *values);
+    void (*wait)(const int want[NFUNC]);
+    void (*finish)(void);                // 通知子进程输入结束
+};
+
+// 管道：每个子进程一个输入管道，结果管道共用
+int in_pipes[NFUNC][MAX_WORKERS][2];
+int res_pipe[2];       // 结果管道(加法可以交换，所以不关注xy的顺序，可以复用结果管道)
+
+void set_nonblock(int fd) {
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+        perror("fcntl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void pipe_setup(void) {
+    if (pipe(res_pipe) == -1) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    for (int f = 0; f < NFUNC; f++) {
+        for (int w = 0; w < nworker; w++) {
+            if (pipe(in_pipes[f][w]) == -1) {
+                perror("pipe");
+                exit(EXIT_FAILURE);
+            }
         }
     }
-    
-    // 安全关闭管道
-    close(read_pipe);
-    close(write_pipe);
+}
 
-    puts("done");
-    exit(EXIT_SUCCESS);
+// 子进程只保留自己的输入管道读端和结果管道写端，其他子进程输入管道的写端不关掉的话它们收不到EOF
+void pipe_child_init(int f, int w) {
+    for (int g = 0; g < NFUNC; g++) {
+        for (int v = 0; v < nworker; v++) {
+            if (g != f || v != w) CLOSE_PIPE_END(in_pipes[g][v], 0);
+            CLOSE_PIPE_END(in_pipes[g][v], 1);
+        }
+    }
+    CLOSE_PIPE_END(res_pipe, 0);
 }
 
-// 主进程
-int main(int argc, char *argv[]) {
-    
-    if (argc != 2) {
-        printf("Usage: %s <test_case_num>\n", argv[0]);
+// 父进程的写端和读端都设为非阻塞：一帧不超过PIPE_BUF，非阻塞写要么整帧写入要么EAGAIN；
+// 子进程整帧写入结果，读到帧头时帧体一定也在管道里
+void pipe_parent_init(void) {
+    for (int f = 0; f < NFUNC; f++) {
+        for (int w = 0; w < nworker; w++) {
+            CLOSE_PIPE_END(in_pipes[f][w], 0);
+            set_nonblock(in_pipes[f][w][1]);
+        }
+    }
+    CLOSE_PIPE_END(res_pipe, 1);
+    set_nonblock(res_pipe[0]);
+}
+
+int pipe_child_recv(int f, int w, struct frame *hdr, unsigned *values) {
+    if (!read_full(in_pipes[f][w][0], hdr, sizeof(*hdr))) return 0;
+    if (hdr->count > MAX_BATCH) {
+        fprintf(stderr, "frame %u too large: %u\n", hdr->id, hdr->count);
         exit(EXIT_FAILURE);
     }
-    int test_case_num = atoi(argv[1]);
-    if (test_case_num < 0||test_case_num > 1) {
-        printf("Test case number must be 0 or 1.\n");
+    read_full(in_pipes[f][w][0], values, frame_body_len(hdr));
+    return 1;
+}
+
+void pipe_child_send(int f, int w, const struct frame *hdr, const unsigned *values) {
+    (void)f, (void)w;
+    write_frame(res_pipe[1], hdr, values);
+}
+
+int pipe_try_send(int f, int w, const struct frame *hdr, const unsigned *values) {
+    return write_frame(in_pipes[f][w][1], hdr, values);
+}
+
+int pipe_try_recv(struct frame *hdr, unsigned *values) {
+    ssize_t bytes = read(res_pipe[0], hdr, sizeof(*hdr));
+    if (bytes == -1 && (errno == EAGAIN || errno == EINTR)) return 0;
+    if (bytes != sizeof(*hdr) || hdr->count > MAX_BATCH) {
+        fprintf(stderr, "unexpected result frame\n");
         exit(EXIT_FAILURE);
     }
+    read_full(res_pipe[0], values, frame_body_len(hdr));
+    return 1;
+}
 
-    // 初始化管道
-    if (pipe(x_pipe) == -1 || pipe(y_pipe) == -1 || pipe(res_pipe) == -1) {
-        perror("pipe");
+// 管道可写时poll返回POLLOUT，表示至少能写入PIPE_BUF字节，正好放得下一帧
+void pipe_wait(const int want[NFUNC]) {
+    struct pollfd fds[NFUNC + 1];
+    int nfd = 0;
+    for (int f = 0; f < NFUNC; f++)
+        if (want[f] >= 0) fds[nfd++] = (struct pollfd) { in_pipes[f][want[f]][1], POLLOUT, 0 };
+    fds[nfd++] = (struct pollfd) { res_pipe[0], POLLIN, 0 };
+    if (poll(fds, nfd, -1) == -1 && errno != EINTR) {
+        perror("poll");
         exit(EXIT_FAILURE);
     }
+}
+
+void pipe_finish(void) {
+    for (int f = 0; f < NFUNC; f++)
+        for (int w = 0; w < nworker; w++) CLOSE_PIPE_END(in_pipes[f][w], 1);
+    CLOSE_PIPE_END(res_pipe, 0);
+}
+
+// 共享内存：每个子进程一对环形缓冲区，请求环由父进程写、子进程读，结果环反之，都是单生产者单消费者。
+// 子进程只等自己的环；父进程要同时等所有环，所以子进程每读走一帧或写入一帧都敲一下门铃doorbell，
+// 父进程没有事可做时睡在门铃上
+struct shm_region {
+    _Atomic uint32_t doorbell;
+    _Atomic uint32_t parent_waiting;
+    char pad[56];
+    struct ring rings[];         // 第(f,w)个子进程的请求环和结果环，见req_ring/res_ring
+};
+struct shm_region *shm;
+size_t shm_size;
+int next_ring;                   // 父进程轮流检查结果环的起点
+
+struct ring *req_ring(int f, int w) { return &shm->rings[2 * (f * nworker + w)]; }
+struct ring *res_ring(int f, int w) { return &shm->rings[2 * (f * nworker + w) + 1]; }
 
-    // 创建计算f(x)的子进程
-    pid_t pid_x = fork();
-    if (pid_x == 0) {
-        child_process(x_pipe[0], res_pipe[1], factorial);
-    } else if (pid_x == -1) {
-        perror("fork x");
+#define MAX_FRAME (sizeof(struct frame) + MAX_BATCH * sizeof(unsigned))
+
+void shm_setup(void) {
+    shm_size = sizeof(struct shm_region) + sizeof(struct ring) * 2 * NFUNC * nworker;
+    shm = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
         exit(EXIT_FAILURE);
     }
+}
+
+void shm_child_init(int f, int w) { (void)f, (void)w; }
+void shm_parent_init(void) {}
+
+int ring_readable(void *arg) {
+    struct ring *r = arg;
+    return ring_used(r) > 0 || atomic_load(&r->closed);
+}
+int ring_writable(void *arg) {
+    return RING_SIZE - ring_used(arg) >= MAX_FRAME;
+}
+
+int shm_child_recv(int f, int w, struct frame *hdr, unsigned *values) {
+    struct ring *r = req_ring(f, w);
+    wait_until(&r->seq, &r->waiting, ring_readable, r);
+    if (!ring_try_read(r, hdr, sizeof(*hdr), values, frame_body_len)) return 0;  // 已关闭且读完
+    notify(&shm->doorbell, &shm->parent_waiting);
+    return 1;
+}
+
+void shm_child_send(int f, int w, const struct frame *hdr, const unsigned *values) {
+    struct ring *r = res_ring(f, w);
+    wait_until(&r->seq, &r->waiting, ring_writable, r);
+    ring_try_write(r, hdr, sizeof(*hdr), values, frame_body_len(hdr));
+    notify(&shm->doorbell, &shm->parent_waiting);
+}
+
+int shm_try_send(int f, int w, const struct frame *hdr, const unsigned *values) {
+    struct ring *r = req_ring(f, w);
+    if (!ring_try_write(r, hdr, sizeof(*hdr), values, frame_body_len(hdr))) return 0;
+    notify(&r->seq, &r->waiting);
+    return 1;
+}
+
+int shm_try_recv(struct frame *hdr, unsigned *values) {
+    for (int k = 0; k < NFUNC * nworker; k++) {
+        int i = (next_ring + k) % (NFUNC * nworker);
+        struct ring *r = res_ring(i / nworker, i % nworker);
+        if (ring_try_read(r, hdr, sizeof(*hdr), values, frame_body_len)) {
+            notify(&r->seq, &r->waiting);
+            next_ring = i + 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int parent_ready(void *arg) {
+    const int *want = arg;
+    for (int f = 0; f < NFUNC; f++) {
+        if (want[f] >= 0 && ring_writable(req_ring(f, want[f]))) return 1;
+        for (int w = 0; w < nworker; w++)
+            if (ring_used(res_ring(f, w)) > 0) return 1;
+    }
+    return 0;
+}
+
+void shm_wait(const int want[NFUNC]) {
+    wait_until(&shm->doorbell, &shm->parent_waiting, parent_ready, (void *)want);
+}
+
+void shm_finish(void) {
+    for (int f = 0; f < NFUNC; f++) {
+        for (int w = 0; w < nworker; w++) {
+            struct ring *r = req_ring(f, w);
+            atomic_store(&r->closed, 1);
+            notify(&r->seq, &r->waiting);
+        }
+    }
+}
+
+const struct transport transports[] = {
+    { "pipe", pipe_setup, pipe_child_init, pipe_parent_init, pipe_child_recv, pipe_child_send,
+      pipe_try_send, pipe_try_recv, pipe_wait, pipe_finish },
+    { "shm", shm_setup, shm_child_init, shm_parent_init, shm_child_recv, shm_child_send,
+      shm_try_send, shm_try_recv, shm_wait, shm_finish },
+};
+const struct transport *tp = &transports[0];
+pid_t pids[NFUNC][MAX_WORKERS];
+
+// 任务的调度方式：static时父进程把f(x)的帧只发给算f(x)的子进程，f(y)同理；
+// steal时任务放进共享内存里每个子进程一个的双端队列，子进程先做自己队列里的，
+// 空了就从别的队列尾部偷，任何子进程都能算任何函数。结果仍然经由传输方式送回
+enum { SCHED_STATIC, SCHED_STEAL };
+int sched = SCHED_STATIC;
+
+#define DEQUE_CAP 16
+
+struct task {
+    struct frame hdr;
+    int func;
+    unsigned values[MAX_BATCH];
+};
+
+// 每个子进程一个。head..tail之间是排队的任务，由lock保护；父进程和偷任务的子进程从尾部进出，
+// 队列的主人从头部取。统计只由执行任务的子进程自己写
+struct deque {
+    _Atomic uint32_t lock;
+    _Atomic uint32_t head, tail;     // 只增不减，无锁读取时只作为有没有任务的提示
+    uint64_t tasks, stolen, busy_ns; // 执行的任务数、其中偷来的个数、忙碌时间
+    char pad[24];
+    struct task slots[DEQUE_CAP];
+};
+
+struct task_pool {
+    _Atomic uint32_t seq, waiting;   // 没有任务可做的子进程睡在seq上
+    _Atomic uint32_t closed;
+    char pad[52];
+    struct deque deques[];           // 第(f,w)个子进程的队列在 f*nworker+w
+};
+struct task_pool *pool;
+size_t pool_size;
+
+struct deque *deque_of(int f, int w) { return &pool->deques[f * nworker + w]; }
+
+void deque_lock(struct deque *q) {
+    while (atomic_exchange_explicit(&q->lock, 1, memory_order_acquire))
+        sched_yield();      // 临界区只有一次拷贝，持锁者被换下CPU时让出去
+}
+void deque_unlock(struct deque *q) {
+    atomic_store_explicit(&q->lock, 0, memory_order_release);
+}
+
+// 父进程把任务放进(f,w)的队列尾部，满了返回0
+int pool_push(int f, int w, const struct frame *hdr, const unsigned *values) {
+    struct deque *q = deque_of(f, w);
+    deque_lock(q);
+    uint32_t tail = atomic_load(&q->tail);
+    int ok = tail - atomic_load(&q->head) < DEQUE_CAP;
+    if (ok) {
+        struct task *t = &q->slots[tail % DEQUE_CAP];
+        t->hdr = *hdr;
+        t->func = f;
+        memcpy(t->values, values, frame_body_len(hdr));
+        atomic_store(&q->tail, tail + 1);
+    }
+    deque_unlock(q);
+    if (ok) notify(&pool->seq, &pool->waiting);
+    return ok;
+}
+
+// 从队列头部（主人）或尾部（偷）取一个任务
+int deque_take(struct deque *q, struct task *t, int steal) {
+    if (atomic_load(&q->head) == atomic_load(&q->tail)) return 0;
+    deque_lock(q);
+    uint32_t head = atomic_load(&q->head), tail = atomic_load(&q->tail);
+    int ok = head != tail;
+    if (ok && steal) {
+        *t = q->slots[(tail - 1) % DEQUE_CAP];
+        atomic_store(&q->tail, tail - 1);
+    } else if (ok) {
+        *t = q->slots[head % DEQUE_CAP];
+        atomic_store(&q->head, head + 1);
+    }
+    deque_unlock(q);
+    return ok;
+}
+
+int pool_ready(void *arg) {
+    (void)arg;
+    if (atomic_load(&pool->closed)) return 1;
+    for (int i = 0; i < NFUNC * nworker; i++)
+        if (atomic_load(&pool->deques[i].head) != atomic_load(&pool->deques[i].tail)) return 1;
+    return 0;
+}
+
+// 子进程取下一个任务：先自己的队列，再从下一个子进程开始轮流偷；都空时睡眠，关闭且全空时返回0
+int pool_take(int f, int w, struct task *t, int *stolen) {
+    int self = f * nworker + w, n = NFUNC * nworker;
+    for (;;) {
+        for (int k = 0; k < n; k++) {
+            if (deque_take(&pool->deques[(self + k) % n], t, k > 0)) {
+                *stolen = k > 0;
+                return 1;
+            }
+        }
+        if (atomic_load(&pool->closed)) return 0;
+        wait_until(&pool->seq, &pool->waiting, pool_ready, NULL);
+    }
+}
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
-    // 创建计算f(y)的子进程
-    pid_t pid_y = fork();
-    if (pid_y == 0) {
-        child_process(y_pipe[0], res_pipe[1], fibonacci);
-    } else if (pid_y == -1) {
-        perror("fork y");
+// 大数内核：结果依次编码后每MAX_BATCH个值发一帧。f、w是执行任务的子进程，func是要算的函数
+void child_send_big(int func, int f, int w, const struct frame *req, const unsigned *inputs) {
+    unsigned chunk[MAX_BATCH];
+    struct frame hdr = { req->id, 0, FRAME_MORE };
+    struct bigint r = { 0 };
+    for (uint32_t i = 0; i < req->count; i++) {
+        big_funcs[func](&r, inputs[i]);
+        for (int64_t k = -1; k < r.len; k++) {
+            chunk[hdr.count++] = k < 0 ? r.len : r.d[k];
+            if (hdr.count == MAX_BATCH) {
+                tp->child_send(f, w, &hdr, chunk);
+                hdr.count = 0;
+            }
+        }
+    }
+    hdr.flags = 0;
+    tp->child_send(f, w, &hdr, chunk);
+    big_free(&r);
+}
+
+// 计算一个任务并送回结果
+void run_task(int func, int f, int w, struct frame *hdr, unsigned *values) {
+    if (kernel == KERNEL_BIG) {
+        child_send_big(func, f, w, hdr, values);
+        return;
+    }
+    for (uint32_t i = 0; i < hdr->count; i++) values[i] = funcs[func](values[i]);
+    tp->child_send(f, w, hdr, values);
+}
+
+// 子进程（实现函数复用）：逐个取任务、计算、写回，直到输入结束
+void child_process(int f, int w) {
+    struct deque *q = deque_of(f, w);
+    tp->child_init(f, w);
+    if (sched == SCHED_STEAL) {
+        struct task t;
+        int stolen;
+        while (pool_take(f, w, &t, &stolen)) {
+            uint64_t begin = now_ns();
+            run_task(t.func, f, w, &t.hdr, t.values);
+            q->busy_ns += now_ns() - begin;
+            q->tasks++;
+            q->stolen += stolen;
+        }
+    } else {
+        struct frame hdr;
+        unsigned values[MAX_BATCH];
+        while (tp->child_recv(f, w, &hdr, values)) {
+            uint64_t begin = now_ns();
+            run_task(f, f, w, &hdr, values);
+            q->busy_ns += now_ns() - begin;
+            q->tasks++;
+        }
+    }
+    exit(EXIT_SUCCESS);
+}
+
+void start_workers(void) {
+    fflush(stdout);   // 子进程不能带着父进程缓冲区里的输出
+    tp->setup();
+    // 两种调度方式都用任务池里的统计，static时队列不用，只映射不访问的页不占内存。
+    // 上一轮的任务池留到这里才释放，子进程退出之后父进程还要读统计
+    if (pool) munmap(pool, pool_size);
+    pool_size = sizeof(struct task_pool) + sizeof(struct deque) * NFUNC * nworker;
+    pool = mmap(NULL, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED) {
+        perror("mmap");
         exit(EXIT_FAILURE);
     }
-    
-    // 关闭不需要的管道端
-    CLOSE_PIPE_END(x_pipe, 0);
-    CLOSE_PIPE_END(y_pipe, 0);
-    CLOSE_PIPE_END(res_pipe, 1);
+    for (int f = 0; f < NFUNC; f++) {
+        for (int w = 0; w < nworker; w++) {
+            pids[f][w] = fork();
+            if (pids[f][w] == -1) {
+                perror("fork");
+                exit(EXIT_FAILURE);
+            }
+            if (pids[f][w] == 0) child_process(f, w);
+        }
+    }
+    tp->parent_init();
+}
+
+// 通知输入结束让子进程退出，并回收
+void stop_workers(void) {
+    tp->finish();
+    atomic_store(&pool->closed, 1);
+    notify(&pool->seq, &pool->waiting);
+    for (int f = 0; f < NFUNC; f++)
+        for (int w = 0; w < nworker; w++) waitpid(pids[f][w], NULL, 0);
+    if (shm) {
+        munmap(shm, shm_size);
+        shm = NULL;
+    }
+}
+
+// 一批输入：函数f对in[offset, offset+count)
+struct batch {
+    int func;
+    uint32_t offset, count;
+    uint64_t sent_ns;       // 发出的时间，用于统计任务延迟
+    uint32_t done;          // 大数内核：已收齐的结果个数
+    uint32_t left;          // 大数内核：当前结果还差的位数，0表示下一个值是位数
+    struct bigint *cur;     // 大数内核：正在接收的结果
+};
+
+// 最近一次dispatch()里每个任务从发出到结果收齐的时间
+uint64_t *latencies;
+uint32_t nlatency;
 
-    // 测试数据
-    struct TestCase { unsigned x, y; } tests[] = {{1, 2}, {5, 5}};
+// 收到一个结果帧时的处理，ctx由调用dispatch()的一方给出
+typedef void (*result_fn)(void *ctx, struct batch *b, const struct frame *hdr, const unsigned *values);
 
-    // 发送数据
-    if (write(x_pipe[1], &tests[test_case_num].x, sizeof(tests[test_case_num].x)) == -1) {
-        perror("write x");
-        CLOSE_PIPE_END(x_pipe, 1);
-        CLOSE_PIPE_END(y_pipe, 1);
-        CLOSE_PIPE_END(res_pipe, 0);
+// 把in[f][0..n[f])按batch_size切成帧轮流发给函数f的各个子进程，结果帧交给on_result。
+// 发送和接收交替进行，都做不了时才等待，避免结果写满时子进程和父进程互相等待
+void dispatch(unsigned *in[NFUNC], const uint32_t n[NFUNC], uint32_t batch_size, result_fn on_result, void *ctx) {
+    uint32_t total = 0;
+    for (int f = 0; f < NFUNC; f++) total += (n[f] + batch_size - 1) / batch_size;
+    struct batch *batches = malloc(sizeof(struct batch) * total + 1);
+    uint32_t sent[NFUNC] = { 0 };   // 各函数已发出的输入个数
+    int next_worker[NFUNC] = { 0 };
+    uint32_t nbatch = 0, finished = 0;
+    unsigned values[MAX_BATCH];
+    free(latencies);
+    latencies = malloc(sizeof(uint64_t) * total + 1);
+    nlatency = 0;
+    if (!batches || !latencies) {
+        perror("malloc");
         exit(EXIT_FAILURE);
     }
-    puts("write x done");
-    if (write(y_pipe[1], &tests[test_case_num].y, sizeof(tests[test_case_num].y)) == -1) {
-        perror("write y");
-        CLOSE_PIPE_END(x_pipe, 1);
-        CLOSE_PIPE_END(y_pipe, 1);
-        CLOSE_PIPE_END(res_pipe, 0);
+
+    while (finished < total) {
+        int progress = 0, want[NFUNC];
+        for (int f = 0; f < NFUNC; f++) {
+            while (sent[f] < n[f]) {
+                uint32_t count = n[f] - sent[f] < batch_size ? n[f] - sent[f] : batch_size;
+                struct frame hdr = { nbatch, count, 0 };
+                int ok = sched == SCHED_STEAL ? pool_push(f, next_worker[f], &hdr, in[f] + sent[f])
+                                              : tp->try_send(f, next_worker[f], &hdr, in[f] + sent[f]);
+                if (!ok) break;
+                batches[nbatch++] = (struct batch) { f, sent[f], count, now_ns(), 0, 0, NULL };
+                sent[f] += count;
+                next_worker[f] = (next_worker[f] + 1) % nworker;
+                progress = 1;
+            }
+            // steal时队列满了只能等子进程取走任务，而取走的任务总会送回结果，等结果即可
+            want[f] = sent[f] < n[f] && sched == SCHED_STATIC ? next_worker[f] : -1;
+        }
+        struct frame hdr;
+        while (tp->try_recv(&hdr, values)) {
+            if (hdr.id >= nbatch) {
+                fprintf(stderr, "unexpected result frame\n");
+                exit(EXIT_FAILURE);
+            }
+            on_result(ctx, &batches[hdr.id], &hdr, values);
+            if (!(hdr.flags & FRAME_MORE)) {
+                finished++;
+                latencies[nlatency++] = now_ns() - batches[hdr.id].sent_ns;
+            }
+            progress = 1;
+        }
+        if (!progress) tp->wait(want);
+    }
+    free(batches);
+}
+
+void store_words(void *ctx, struct batch *b, const struct frame *hdr, const unsigned *values) {
+    unsigned **out = ctx;
+    if (hdr->count != b->count || hdr->flags) {
+        fprintf(stderr, "unexpected result frame\n");
         exit(EXIT_FAILURE);
     }
-    puts("write y done");
+    memcpy(out[b->func] + b->offset, values, hdr->count * sizeof(unsigned));
+}
+
+// 用word内核计算in[f][0..n)，结果填入out[f]
+void evaluate(unsigned *in[NFUNC], unsigned *out[NFUNC], uint32_t n, uint32_t batch_size) {
+    uint32_t counts[NFUNC];
+    for (int f = 0; f < NFUNC; f++) counts[f] = n;
+    dispatch(in, counts, batch_size, store_words, out);
+}
+
+// 大数结果的去重表，每个函数一张以输入为键的开放寻址表，只在一次evaluate_big之内有效。
+// 所有子进程的结果都回到父进程，同一批里重复的输入只发出去一次，各处的out指向同一个结果。
+// 每次调用开始时清空，占用随这一批不同输入的个数增长
+struct cache_entry {
+    unsigned key;
+    int used;
+    struct bigint value;
+};
+struct cache {
+    struct cache_entry *slots;
+    size_t cap, size;
+};
+struct cache caches[NFUNC];
+
+// 找key，没有时insert为真则插入一个空的结果。插入可能扩容，之前拿到的指针失效
+struct cache_entry *cache_lookup(struct cache *c, unsigned key, int insert) {
+    if (insert && 2 * (c->size + 1) > c->cap) {
+        struct cache old = *c;
+        c->cap = old.cap ? 2 * old.cap : 64;
+        c->slots = calloc(c->cap, sizeof(struct cache_entry));
+        if (!c->slots) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+        c->size = 0;
+        for (size_t i = 0; i < old.cap; i++) {
+            if (!old.slots[i].used) continue;
+            *cache_lookup(c, old.slots[i].key, 1) = old.slots[i];
+        }
+        free(old.slots);
+    }
+    if (c->cap == 0) return NULL;
+    for (size_t i = (key * 0x9E3779B1u) & (c->cap - 1);; i = (i + 1) & (c->cap - 1)) {
+        struct cache_entry *e = &c->slots[i];
+        if (e->used && e->key == key) return e;
+        if (!e->used) {
+            if (!insert) return NULL;
+            *e = (struct cache_entry) { key, 1, { 0 } };
+            c->size++;
+            return e;
+        }
+    }
+}
 
-    // 关闭写端触发EOF
-    CLOSE_PIPE_END(x_pipe, 1);
-    CLOSE_PIPE_END(y_pipe, 1);
+void cache_clear(struct cache *c) {
+    for (size_t i = 0; i < c->cap; i++)
+        if (c->slots[i].used) big_free(&c->slots[i].value);
+    free(c->slots);
+    *c = (struct cache) { 0 };
+}
+
+// 结果帧里的值依次是 位数, 各位...，可能在任何位置被切到下一帧
+void store_bigints(void *ctx, struct batch *b, const struct frame *hdr, const unsigned *values) {
+    unsigned **todo = ctx;
+    struct cache *c = &caches[b->func];
+    for (uint32_t i = 0; i < hdr->count; i++) {
+        if (b->left == 0) {
+            if (b->done == b->count) {
+                fprintf(stderr, "unexpected result frame\n");
+                exit(EXIT_FAILURE);
+            }
+            b->cur = &cache_lookup(c, todo[b->func][b->offset + b->done], 0)->value;
+            big_reserve(b->cur, values[i]);
+            b->cur->len = values[i];
+            if ((b->left = values[i]) == 0) b->done++;
+        } else {
+            b->cur->d[b->cur->len - b->left] = values[i];
+            if (--b->left == 0) b->done++;
+        }
+    }
+}
 
-    // 读取并汇总结果
-    unsigned fx, fy;
+// 用大数内核计算in[f][0..n)，out[f][i]指向表里的结果，下次调用之前有效
+void evaluate_big(unsigned *in[NFUNC], const struct bigint **out[NFUNC], uint32_t n, uint32_t batch_size) {
+    for (int f = 0; f < NFUNC; f++) cache_clear(&caches[f]);
 
-    if (read(res_pipe[0], &fx, sizeof(fx)) == -1 || 
-        read(res_pipe[0], &fy, sizeof(fy)) == -1) {
-        perror("read result");
-        CLOSE_PIPE_END(x_pipe, 1);
-        CLOSE_PIPE_END(y_pipe, 1);
-        CLOSE_PIPE_END(res_pipe, 0);
+    unsigned *todo[NFUNC];
+    uint32_t ntodo[NFUNC] = { 0 };
+    for (int f = 0; f < NFUNC; f++) {
+        todo[f] = malloc(sizeof(unsigned) * (n ? n : 1));
+        if (!todo[f]) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (cache_lookup(&caches[f], in[f][i], 0)) continue;
+            cache_lookup(&caches[f], in[f][i], 1);
+            todo[f][ntodo[f]++] = in[f][i];
+        }
+    }
+    dispatch(todo, ntodo, batch_size, store_bigints, todo);
+    for (int f = 0; f < NFUNC; f++) {
+        for (uint32_t i = 0; i < n; i++) out[f][i] = &cache_lookup(&caches[f], in[f][i], 0)->value;
+        free(todo[f]);
+    }
+}
+
+int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 最近一次计算的任务延迟分位数和各子进程的负载，在stop_workers()之后调用
+void print_stats(void) {
+    qsort(latencies, nlatency, sizeof(uint64_t), compare_u64);
+    if (nlatency > 0) {
+        double p[] = { 0.5, 0.9, 0.99 };
+        printf("task latency (us): tasks=%u", nlatency);
+        for (int i = 0; i < 3; i++) printf(" p%g=%.1f", p[i] * 100, latencies[(uint32_t)(p[i] * (nlatency - 1))] / 1e3);
+        printf(" max=%.1f\n", latencies[nlatency - 1] / 1e3);
+    }
+    printf("worker,home,tasks,stolen,busy_ms\n");
+    for (int f = 0; f < NFUNC; f++) {
+        for (int w = 0; w < nworker; w++) {
+            struct deque *q = deque_of(f, w);
+            printf("%d,%s,%llu,%llu,%.3f\n", f * nworker + w, func_names[f], (unsigned long long)q->tasks,
+                   (unsigned long long)q->stolen, q->busy_ns / 1e6);
+        }
+    }
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 各传输方式在不同帧大小下的往返延迟和吞吐：
+// 延迟为每个函数一帧、等两帧结果都回来的平均时间，吞吐为count组输入的批量计算
+void benchmark(long count) {
+    static const uint32_t sizes[] = { 1, 16, 128, MAX_BATCH };
+    const int reps = 2000;
+    unsigned *in[NFUNC], *out[NFUNC];
+    for (int f = 0; f < NFUNC; f++) {
+        in[f] = malloc(sizeof(unsigned) * count);
+        out[f] = malloc(sizeof(unsigned) * count);
+        if (!in[f] || !out[f]) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (long i = 0; i < count; i++) in[f][i] = i % 13;
+    }
+    printf("transport,workers,frame_values,frame_bytes,rtt_us,mvalues_per_s,mb_per_s\n");
+    for (size_t t = 0; t < sizeof(transports) / sizeof(transports[0]); t++) {
+        tp = &transports[t];
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t size = sizes[s];
+            start_workers();
+            double begin = now_seconds();
+            for (int r = 0; r < reps; r++) evaluate(in, out, size, size);
+            double rtt = (now_seconds() - begin) / reps;
+            begin = now_seconds();
+            evaluate(in, out, count, size);
+            double seconds = now_seconds() - begin;
+            stop_workers();
+            // 每组输入来回各一个值
+            double values = (double)count * NFUNC;
+            printf("%s,%d,%u,%zu,%.2f,%.2f,%.1f\n", tp->name, nworker, size,
+                   sizeof(struct frame) + size * sizeof(unsigned), rtt * 1e6, values / seconds / 1e6,
+                   values * 2 * sizeof(unsigned) / seconds / 1e6);
+            fflush(stdout);
+        }
+    }
+    for (int f = 0; f < NFUNC; f++) {
+        free(in[f]);
+        free(out[f]);
+    }
+}
+
+void usage(const char *prog) {
+    printf("Usage: %s [-t transport] [-w workers] [-b batch] <test_case_num>\n"
+           "       %s [-t transport] [-w workers] [-b batch] -              从标准输入逐行读入 x y\n"
+           "       %s [-t transport] [-w workers] [-b batch] -n count      计算count组f(x,y)并计时\n"
+           "       %s -B [-w workers] [-n count]                          比较各传输方式的延迟和吞吐\n"
+           "  -k kernel     word（默认，unsigned，会溢出）或big（任意精度，同一批里重复的输入只算一次）\n"
+           "  -m max        -n时输入取 i %% (max+1)，默认word为12和47，big为1000\n"
+           "  -t transport  pipe（默认）或shm（共享内存环形缓冲区）\n"
+           "  -s sched      static（默认，f(x)只发给算f(x)的子进程）或steal（共享任务队列，空闲的子进程偷任务）\n"
+           "  -w workers    每个函数的子进程数，默认1，最多%d\n"
+           "  -b batch      每帧的值个数，默认和最大值都是%zu\n",
+           prog, prog, prog, prog, MAX_WORKERS, MAX_BATCH);
+}
+
+// 主进程
+int main(int argc, char *argv[]) {
+    uint32_t batch_size = MAX_BATCH;
+    long count = 0;
+    int bench = 0;
+    long max = -1;
+    for (int c; (c = getopt(argc, argv, "k:m:t:s:w:b:n:Bh")) != -1;) {
+        switch (c) {
+        case 'k':
+            if (strcmp(optarg, "word") == 0) kernel = KERNEL_WORD;
+            else if (strcmp(optarg, "big") == 0) kernel = KERNEL_BIG;
+            else {
+                fprintf(stderr, "unknown kernel: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'm': max = atol(optarg); break;
+        case 't':
+            tp = NULL;
+            for (size_t t = 0; t < sizeof(transports) / sizeof(transports[0]); t++)
+                if (strcmp(optarg, transports[t].name) == 0) tp = &transports[t];
+            if (!tp) {
+                fprintf(stderr, "unknown transport: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            if (strcmp(optarg, "static") == 0) sched = SCHED_STATIC;
+            else if (strcmp(optarg, "steal") == 0) sched = SCHED_STEAL;
+            else {
+                fprintf(stderr, "unknown scheduling: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'B': bench = 1; break;
+        case 'w': nworker = atoi(optarg); break;
+        case 'b': batch_size = atoi(optarg); break;
+        case 'n': count = atol(optarg); break;
+        default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - (count > 0 || bench ? 0 : 1) || nworker < 1 || nworker > MAX_WORKERS
+        || batch_size < 1 || batch_size > MAX_BATCH || count < 0 || count > UINT32_MAX / NFUNC) {
+        usage(argv[0]);
         exit(EXIT_FAILURE);
     }
-    printf("f(%u,%u) = %u + %u = %u\n", tests[test_case_num].x, tests[test_case_num].y, fx, fy, fx + fy);
-    
-    CLOSE_PIPE_END(res_pipe, 0);
-    // 清理资源
-    waitpid(pid_x, NULL, 0);
-    waitpid(pid_y, NULL, 0);
+    if (bench && kernel != KERNEL_WORD) {
+        fprintf(stderr, "-B measures the transport with the word kernel only\n");
+        exit(EXIT_FAILURE);
+    }
+    if (bench) {
+        benchmark(count > 0 ? count : 1 << 20);
+        return EXIT_SUCCESS;
+    }
+
+    // 准备输入
+    uint32_t n = 0, cap = 16;
+    unsigned *in[NFUNC], *out[NFUNC];
+    const struct bigint **big_out[NFUNC];
+    int from_stdin = count == 0 && strcmp(argv[optind], "-") == 0;
+    if (count > 0) cap = count;
+    for (int f = 0; f < NFUNC; f++) {
+        in[f] = malloc(sizeof(unsigned) * cap);
+        if (!in[f]) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (count > 0) {
+        // 默认是结果在unsigned范围内不溢出的输入
+        if (max < 0 && kernel == KERNEL_BIG) max = 1000;
+        for (n = 0; n < count; n++) {
+            in[0][n] = max < 0 ? n % 13 : n % (max + 1);
+            in[1][n] = max < 0 ? n % 48 : n % (max + 1);
+        }
+    } else if (from_stdin) {
+        unsigned x, y;
+        while (scanf("%u %u", &x, &y) == 2) {
+            if (n == cap) {
+                cap *= 2;
+                for (int f = 0; f < NFUNC; f++) {
+                    if (!(in[f] = realloc(in[f], sizeof(unsigned) * cap))) {
+                        perror("realloc");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+            }
+            in[0][n] = x;
+            in[1][n] = y;
+            n++;
+        }
+    } else {
+        int test_case_num = atoi(argv[optind]);
+        if (test_case_num < 0||test_case_num > 1) {
+            printf("Test case number must be 0 or 1.\n");
+            exit(EXIT_FAILURE);
+        }
+        // 测试数据
+        struct TestCase { unsigned x, y; } tests[] = {{1, 2}, {5, 5}};
+        in[0][0] = tests[test_case_num].x;
+        in[1][0] = tests[test_case_num].y;
+        n = 1;
+    }
+    for (int f = 0; f < NFUNC; f++) {
+        out[f] = malloc(sizeof(unsigned) * (n ? n : 1));
+        big_out[f] = malloc(sizeof(struct bigint *) * (n ? n : 1));
+        if (!out[f] || !big_out[f]) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    start_workers();
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (kernel == KERNEL_BIG) evaluate_big(in, big_out, n, batch_size);
+    else evaluate(in, out, n, batch_size);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stop_workers();
+
+    if (kernel == KERNEL_BIG && count > 0) {
+        // 校验和取各结果的最低9位十进制数字之和
+        unsigned long long sum = 0;
+        for (uint32_t i = 0; i < n; i++)
+            for (int f = 0; f < NFUNC; f++) sum += big_out[f][i]->len ? big_out[f][i]->d[0] : 0;
+        double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        printf("%u evaluations in %.3f ms (%.0f/s), checksum %llu\n", n, seconds * 1e3, n / seconds, sum);
+        print_stats();
+    } else if (kernel == KERNEL_BIG) {
+        struct bigint sum = { 0 };
+        for (uint32_t i = 0; i < n; i++) {
+            big_add(&sum, big_out[0][i], big_out[1][i]);
+            printf("f(%u,%u) = ", in[0][i], in[1][i]);
+            big_print(stdout, big_out[0][i]);
+            printf(" + ");
+            big_print(stdout, big_out[1][i]);
+            printf(" = ");
+            big_print(stdout, &sum);
+            printf("\n");
+        }
+        big_free(&sum);
+    } else if (count > 0) {
+        unsigned long long sum = 0;
+        for (uint32_t i = 0; i < n; i++) sum += out[0][i] + out[1][i];
+        double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+        printf("%u evaluations in %.3f ms (%.0f/s), checksum %llu\n", n, seconds * 1e3, n / seconds, sum);
+        print_stats();
+    } else {
+        for (uint32_t i = 0; i < n; i++)
+            printf("f(%u,%u) = %u + %u = %u\n", in[0][i], in[1][i], out[0][i], out[1][i], out[0][i] + out[1][i]);
+    }
+    for (int f = 0; f < NFUNC; f++) {
+        free(in[f]);
+        free(out[f]);
+        free(big_out[f]);
+        cache_clear(&caches[f]);
+    }
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
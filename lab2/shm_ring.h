@@ -0,0 +1,96 @@
+// 共享内存上的单生产者单消费者环形缓冲区，按帧收发，用futex在空/满时等待
+// 环形缓冲区在fork之前用MAP_SHARED映射，父子进程看到的是同一块内存
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define RING_SIZE (1 << 16)   // 字节数，必须是2的幂
+#define RING_SPIN 128         // 睡眠之前先自旋检查的次数
+
+// head和tail只增不减，取模后才是缓冲区里的位置；分在不同的缓存行上，两端互不干扰
+// seq是futex字，状态每变一次加一；waiting是睡在seq上的进程数，不为0时才需要futex_wake
+struct ring {
+    _Atomic uint64_t head;       // 消费者读到的位置
+    char pad1[56];
+    _Atomic uint64_t tail;       // 生产者写到的位置
+    char pad2[56];
+    _Atomic uint32_t seq;
+    _Atomic uint32_t waiting;
+    _Atomic uint32_t closed;     // 生产者不会再写
+    char buf[RING_SIZE];
+};
+
+static inline void futex_wait(_Atomic uint32_t *addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+static inline void futex_wake(_Atomic uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// 改变状态之后通知可能在等待的一方。seq的加一和waiting的读取都是seq_cst，
+// 与等待方先登记waiting再复查条件配对，不会丢失唤醒
+static inline void notify(_Atomic uint32_t *seq, _Atomic uint32_t *waiting) {
+    atomic_fetch_add(seq, 1);
+    if (atomic_load(waiting)) futex_wake(seq);
+}
+
+// 等到ready(arg)为真：先自旋，再登记到waiting、复查、睡在seq上。可以有多个进程同时等待
+static inline void wait_until(_Atomic uint32_t *seq, _Atomic uint32_t *waiting,
+                              int (*ready)(void *), void *arg) {
+    for (int i = 0; i < RING_SPIN; i++)
+        if (ready(arg)) return;
+    while (!ready(arg)) {
+        uint32_t s = atomic_load(seq);
+        atomic_fetch_add(waiting, 1);
+        if (!ready(arg)) futex_wait(seq, s);
+        atomic_fetch_sub(waiting, 1);
+    }
+}
+
+static inline size_t ring_used(struct ring *r) {
+    return atomic_load_explicit(&r->tail, memory_order_acquire) - atomic_load_explicit(&r->head, memory_order_acquire);
+}
+
+static inline void ring_copy_in(struct ring *r, uint64_t pos, const void *src, size_t len) {
+    size_t off = pos & (RING_SIZE - 1), first = len < RING_SIZE - off ? len : RING_SIZE - off;
+    memcpy(r->buf + off, src, first);
+    memcpy(r->buf, (const char *)src + first, len - first);
+}
+
+static inline void ring_copy_out(struct ring *r, uint64_t pos, void *dst, size_t len) {
+    size_t off = pos & (RING_SIZE - 1), first = len < RING_SIZE - off ? len : RING_SIZE - off;
+    memcpy(dst, r->buf + off, first);
+    memcpy((char *)dst + first, r->buf, len - first);
+}
+
+// 写入header和body两段组成的一帧，空间不够返回0。只能由生产者调用
+static inline int ring_try_write(struct ring *r, const void *header, size_t hlen, const void *body, size_t blen) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (RING_SIZE - (tail - atomic_load_explicit(&r->head, memory_order_acquire)) < hlen + blen) return 0;
+    ring_copy_in(r, tail, header, hlen);
+    ring_copy_in(r, tail + hlen, body, blen);
+    atomic_store_explicit(&r->tail, tail + hlen + blen, memory_order_release);
+    return 1;
+}
+
+// 读出一帧：先读定长的header，由body_len(header)给出body的长度。没有数据返回0。只能由消费者调用
+// 生产者总是整帧发布，所以有header就一定有完整的body
+static inline int ring_try_read(struct ring *r, void *header, size_t hlen,
+                                void *body, size_t (*body_len)(const void *)) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (atomic_load_explicit(&r->tail, memory_order_acquire) == head) return 0;
+    ring_copy_out(r, head, header, hlen);
+    size_t blen = body_len(header);
+    ring_copy_out(r, head + hlen, body, blen);
+    atomic_store_explicit(&r->head, head + hlen + blen, memory_order_release);
+    return 1;
+}
+
+#endif
@@ -1,116 +1,526 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <sys/mman.h>
 
-#define NUM_SMOKERS 3
+#include "trace.h"
+
+#define MAX_INGREDIENTS 31  // futex模式用一个32位字的各位表示桌上的材料，最高位另有用处
+#define MAX_SMOKERS 256
 #define SEM_PERM 0666
+#define SPIN 128            // futex模式睡眠之前先自旋检查的次数
+
+// sem：吸烟者是子进程，桌上的每种材料和“抽完了”都是同一个信号量集里的信号量；
+// futex：吸烟者是线程，桌上的材料是一个原子字里的位，按位唤醒对应的吸烟者
+enum { MODE_SEM, MODE_FUTEX, NMODE };
+const char *mode_names[NMODE] = { "sem", "futex" };
+int mode = MODE_SEM;
+
+int ningredient = 3;        // 材料种类数，生产者每轮放上除一种之外的全部
+int nsmoker = 3;            // 第i个吸烟者自带第i % ningredient种材料
+long rounds = 0;            // 大于0时只跑这么多轮，不打印过程，最后输出每秒轮数
+long smoke_us = 2000000;    // 每支烟抽多久
 
 // 全局变量用于信号处理
-pid_t child_pids[NUM_SMOKERS];
-int tobacco_sem, paper_sem, match_sem, smoke_sem;
-
-// 信号量操作辅助宏
-#define SEM_OP(semid, op) do { \
-    struct sembuf sb = {0, (op), SEM_UNDO}; \
-    if(semop(semid, &sb, 1) == -1) { \
-        perror("semop"); \
-        exit(EXIT_FAILURE); \
-    } \
-} while(0)
+pid_t child_pids[MAX_SMOKERS];
+pthread_t threads[MAX_SMOKERS];
+int child_count = 0;
+int semid = -1;             // 第j个信号量是桌上的第j种材料，第ningredient个表示上一支烟抽完了
+#define SEM_DONE ningredient
+
+// 一次semop完成一组操作，要么全部完成要么都不做
+void sem_ops(struct sembuf *ops, int nops) {
+    if (semop(semid, ops, nops) == -1) {
+        perror("semop");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// futex模式的桌子：低位是桌上的材料；SMOKING表示材料已被拿走、正在抽；STOP表示结束
+_Atomic uint32_t table;
+#define SMOKING (1u << 31)
+#define STOP UINT32_MAX
+// 在table上睡眠的数量：第k格是等第k种材料之外全部材料的吸烟者，第ningredient格是等抽完的生产者
+_Atomic uint32_t sleeping[MAX_INGREDIENTS + 1];
+#define AGENT_BIT (1u << 31)
+
+uint32_t all_ingredients(void) { return (1u << ningredient) - 1; }
+
+void futex_wait_bits(uint32_t val, uint32_t bits) {
+    syscall(SYS_futex, &table, FUTEX_WAIT_BITSET_PRIVATE, val, NULL, NULL, bits);
+}
+void futex_wake_bits(int n, uint32_t bits) {
+    syscall(SYS_futex, &table, FUTEX_WAKE_BITSET_PRIVATE, n, NULL, NULL, bits);
+}
+
+// 等到table的值满足ready，返回当时的值。睡眠前登记在sleeping[slot]上、只接受bits的唤醒，
+// 唤醒方改完table再看sleeping，两边都是seq_cst，不会丢失唤醒
+uint32_t table_wait(int (*ready)(uint32_t, int), int arg, int slot, uint32_t bits) {
+    for (int i = 0;; i++) {
+        uint32_t v = atomic_load(&table);
+        if (ready(v, arg)) return v;
+        if (i < SPIN) continue;
+        atomic_fetch_add(&sleeping[slot], 1);
+        futex_wait_bits(v, bits);
+        atomic_fetch_sub(&sleeping[slot], 1);
+    }
+}
+
+void table_set(uint32_t v, int slot, int n, uint32_t bits) {
+    atomic_store(&table, v);
+    if (atomic_load(&sleeping[slot])) futex_wake_bits(n, bits);
+}
+
+int table_empty(uint32_t v, int arg) { (void)arg; return v == 0; }
+// 桌上正好是第k种之外的全部材料，或者已经结束
+int table_for(uint32_t v, int k) { return v == (all_ingredients() & ~(1u << k)) || v == STOP; }
+
+// -T：记录每轮的事件。第0个缓冲区是生产者的，第1+i个是第i个吸烟者的。
+// 交接延迟由醒来的吸烟者自己算：从生产者放材料（或上一位抽完，取较晚者）到拿齐材料。
+// 各轮严格先后进行，醒来时对woken加一得到的就是轮次；post_ns按轮次奇偶分两格，
+// 生产者写下一轮的那一格时，这一轮的吸烟者早已读过
+int tracing = 0;
+struct trace_shared {
+    _Atomic uint32_t woken;
+    char pad1[60];
+    uint64_t post_ns[2];
+    uint64_t done_ns;
+    char pad2[40];
+    struct trace_ring rings[];
+};
+struct trace_shared *tr;
+size_t tr_bytes;
+
+// 材料的名字在启动吸烟者之前填好，之后只读，多个线程同时取也没有竞争
+char ingredient_names[MAX_INGREDIENTS][24] = { "tobacco", "paper", "matches" };
+
+void init_ingredient_names(void) {
+    for (int k = 3; k < MAX_INGREDIENTS; k++) snprintf(ingredient_names[k], sizeof(ingredient_names[k]), "ingredient%d", k);
+}
+
+const char *ingredient_name(int k) { return ingredient_names[k]; }
 
 // 清理函数
 void cleanup() {
-    semctl(tobacco_sem, 0, IPC_RMID);
-    semctl(paper_sem, 0, IPC_RMID);
-    semctl(match_sem, 0, IPC_RMID);
-    semctl(smoke_sem, 0, IPC_RMID);
+    if (semid != -1) semctl(semid, 0, IPC_RMID);
+    semid = -1;
 }
 
 // 信号处理函数
 void sig_handler(int sig) {
-    // 终止所有子进程
-    for(int i = 0; i < NUM_SMOKERS; i++) {
+    // 终止所有子进程（线程随进程一起退出）
+    for(int i = 0; i < child_count && mode == MODE_SEM; i++) {
         if(child_pids[i] > 0) kill(child_pids[i], SIGTERM);
     }
     cleanup();
     exit(EXIT_SUCCESS);
 }
 
-void producer() {
-    const char* materials[] = {"tobacco", "paper", "matches"};
-    int sem_ids[] = {tobacco_sem, paper_sem, match_sem};
+// 子进程只需退出（并输出缓冲区里的内容），清理由父进程负责
+void child_handler(int sig) {
+    exit(EXIT_SUCCESS);
+}
 
-    while(1) {
-        for(int i = rand() % 3;1; i = rand() % 3) { // 随机选择材料
-            // 等待生产者放置材料
-            printf("\nProducer placing %s and %s\n", materials[(i+1)%3], materials[(i+2)%3]);
-            
-            // 提供材料
-            SEM_OP(sem_ids[i], 1);
-            
-            // 等待吸烟完成
-            SEM_OP(smoke_sem, -1);
-        }
+void print_placing(int k) {
+    printf("\nProducer placing ");
+    for (int j = 0, left = ningredient - 1; j < ningredient; j++) {
+        if (j == k) continue;
+        printf("%s%s", ingredient_name(j), --left == 0 ? "\n" : left == 1 ? " and " : ", ");
     }
 }
 
-void smoker(int sem_id, const char* name) {
-    while(1) {
-        // 等待材料
-        SEM_OP(sem_id, -1);
-        
-        printf("%s is smoking\n", name);
-        sleep(2);
-        printf("%s finishes smoking\n", name);
+void trace_post(long r, int k) {
+    uint64_t now = trace_now();
+    tr->post_ns[r & 1] = now;
+    trace_emit(&tr->rings[0], EV_POST, 0, r, k, now);
+}
 
-        // 通知完成
-        SEM_OP(smoke_sem, 1);
+// 生产者：每轮随机留下一种材料，把其余的放上桌，等拿到它们的吸烟者抽完
+void producer() {
+    struct sembuf ops[MAX_INGREDIENTS + 1];
+    for(long r = 0; rounds == 0 || r < rounds; r++) {
+        int k = rand() % ningredient; // 随机选择材料
+        if (mode == MODE_SEM) {
+            int n = 0;
+            ops[n++] = (struct sembuf) { SEM_DONE, -1, 0 };
+            for (int j = 0; j < ningredient; j++)
+                if (j != k) ops[n++] = (struct sembuf) { j, 1, 0 };
+            if (rounds) {
+                // 等上一支烟抽完和放上材料在同一次semop里完成
+                if (tracing) trace_post(r, k);
+                sem_ops(ops, n);
+            } else {
+                // 交互时要在两步之间输出，才排在上一位的finishes smoking之后、这一位的is smoking之前
+                sem_ops(ops, 1);
+                print_placing(k);
+                if (tracing) trace_post(r, k);
+                sem_ops(ops + 1, n - 1);
+            }
+        } else {
+            table_wait(table_empty, 0, ningredient, AGENT_BIT);
+            if (!rounds) print_placing(k);
+            if (tracing) trace_post(r, k);
+            table_set(all_ingredients() & ~(1u << k), k, 1, 1u << k);
+        }
+    }
+    // 等最后一支烟抽完
+    if (mode == MODE_SEM) {
+        struct sembuf done = { SEM_DONE, -1, 0 };
+        sem_ops(&done, 1);
+    } else {
+        table_wait(table_empty, 0, ningredient, AGENT_BIT);
     }
 }
 
-int main() {
-    // 创建信号量集
-    tobacco_sem = semget(IPC_PRIVATE, 1, IPC_CREAT | SEM_PERM);
-    paper_sem = semget(IPC_PRIVATE, 1, IPC_CREAT | SEM_PERM);
-    match_sem = semget(IPC_PRIVATE, 1, IPC_CREAT | SEM_PERM);
-    smoke_sem = semget(IPC_PRIVATE, 1, IPC_CREAT | SEM_PERM);
+void *smoker(void *arg) {
+    int id = (intptr_t)arg, k = id % ningredient;
+    char name[32];
+    // 前三种沿用最初的名字（MatchSmoker而不是MatchesSmoker），之后的由材料名得到
+    static const char *classic[] = { "TobaccoSmoker", "PaperSmoker", "MatchSmoker" };
+    const char *base = ingredient_name(k);
+    if (k < 3) snprintf(name, sizeof(name), "%s", classic[k]);
+    else snprintf(name, sizeof(name), "%c%sSmoker", base[0] - 'a' + 'A', base + 1);
+    if (id >= ningredient) snprintf(name + strlen(name), sizeof(name) - strlen(name), "%d", id / ningredient + 1);
 
-    // 初始化信号量值
-    semctl(tobacco_sem, 0, SETVAL, 0);
-    semctl(paper_sem, 0, SETVAL, 0);
-    semctl(match_sem, 0, SETVAL, 0);
-    semctl(smoke_sem, 0, SETVAL, 0);
+    struct sembuf take[MAX_INGREDIENTS], done = { SEM_DONE, 1, 0 };
+    struct trace_ring *ring = tracing ? &tr->rings[1 + id] : NULL;
+    uint32_t round = 0;
+    int n = 0;
+    for (int j = 0; j < ningredient; j++)
+        if (j != k) take[n++] = (struct sembuf) { j, -1, 0 };
+    while(1) {
+        // 等待材料：一次拿齐其余全部材料，拿不齐就一样都不拿，不会有人攥着一半材料死等
+        if (mode == MODE_SEM) {
+            sem_ops(take, n);
+        } else {
+            uint32_t v;
+            do {
+                v = table_wait(table_for, k, k, 1u << k);
+                if (v == STOP) return NULL;
+            } while (!atomic_compare_exchange_strong(&table, &v, SMOKING));
+        }
+        if (tracing) {
+            uint64_t now = trace_now();
+            round = atomic_fetch_add(&tr->woken, 1);
+            uint64_t from = tr->post_ns[round & 1];
+            if (tr->done_ns > from) from = tr->done_ns;
+            trace_emit(ring, EV_WAKE, 1 + id, round, now - from, now);
+        }
 
-    // 注册信号处理
-    signal(SIGINT, sig_handler);
-    signal(SIGTERM, sig_handler);
+        if (!rounds) printf("%s is smoking\n", name);
+        if (smoke_us) usleep(smoke_us);
+        if (!rounds) printf("%s finishes smoking\n", name);
 
-    // 创建吸烟者进程
-    const char* names[] = {"TobaccoSmoker", "PaperSmoker", "MatchSmoker"};
-    int sem_ids[] = {tobacco_sem, paper_sem, match_sem};
+        // 通知完成
+        if (tracing) {
+            uint64_t now = trace_now();
+            tr->done_ns = now;
+            trace_emit(ring, EV_DONE, 1 + id, round, 0, now);
+        }
+        if (mode == MODE_SEM) sem_ops(&done, 1);
+        else table_set(0, ningredient, 1, AGENT_BIT);
+    }
+}
 
-    for(int i = 0; i < NUM_SMOKERS; i++) {
+void start_smokers(void) {
+    if (mode == MODE_SEM) {
+        // 创建信号量集：各种材料和“抽完了”，开始时桌上是空的，也没有人在抽
+        semid = semget(IPC_PRIVATE, ningredient + 1, IPC_CREAT | SEM_PERM);
+        if (semid == -1) {
+            perror("semget");
+            exit(EXIT_FAILURE);
+        }
+        for (int j = 0; j < ningredient; j++) semctl(semid, j, SETVAL, 0);
+        semctl(semid, SEM_DONE, SETVAL, 1);
+    } else {
+        atomic_store(&table, 0);
+    }
+    if (tracing) {
+        tr_bytes = sizeof(struct trace_shared) + sizeof(struct trace_ring) * (nsmoker + 1);
+        tr = mmap(NULL, tr_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (tr == MAP_FAILED) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fflush(stdout);
+    for(int i = 0; i < nsmoker; i++) {
+        if (mode == MODE_FUTEX) {
+            if (pthread_create(&threads[i], NULL, smoker, (void *)(intptr_t)i) != 0) {
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+            child_count++;
+            continue;
+        }
         pid_t pid = fork();
         if(pid == 0) {
-            smoker(sem_ids[i], names[i]);
+            signal(SIGINT, child_handler);
+            signal(SIGTERM, child_handler);
+            smoker((void *)(intptr_t)i);
             exit(EXIT_SUCCESS);
         } else if(pid > 0) {
-            child_pids[i] = pid;
+            child_pids[child_count++] = pid;
         } else {
             perror("fork");
             cleanup();
             exit(EXIT_FAILURE);
         }
     }
+}
+
+void stop_smokers(void) {
+    for (int i = 0; i < child_count; i++) {
+        if (mode == MODE_SEM) {
+            kill(child_pids[i], SIGTERM);
+            waitpid(child_pids[i], NULL, 0);
+        } else {
+            if (i == 0) {
+                atomic_store(&table, STOP);
+                futex_wake_bits(INT_MAX, FUTEX_BITSET_MATCH_ANY);
+            }
+            pthread_join(threads[i], NULL);
+        }
+    }
+    child_count = 0;
+    cleanup();
+}
+
+// 汇总线程在父进程里，每毫秒取走一遍各缓冲区的事件
+struct smoker_stats {
+    uint64_t served, last_wake, max_gap;
+    uint64_t handoff_sum;
+};
+struct smoker_stats sstats[MAX_SMOKERS];
+uint64_t handoff_hist[HIST_BUCKETS], nhandoff, posts[MAX_INGREDIENTS];
+uint64_t trace_begin, trace_end;
+_Atomic int collecting;
+pthread_t collector_thread;
+
+// 把所有缓冲区里现有的事件取完
+void drain_rings(void) {
+    struct trace_event e;
+    for (int a = 0; a <= nsmoker; a++) {
+        while (trace_take(&tr->rings[a], &e)) {
+            if (e.type == EV_POST) {
+                posts[e.value]++;
+            } else if (e.type == EV_WAKE) {
+                struct smoker_stats *st = &sstats[e.actor - 1];
+                // 两次轮到之间的间隔，第一次从开始算起
+                if (e.ns - st->last_wake > st->max_gap) st->max_gap = e.ns - st->last_wake;
+                st->last_wake = e.ns;
+                st->served++;
+                st->handoff_sum += e.value;
+                handoff_hist[hist_bucket(e.value)]++;
+                nhandoff++;
+            }
+        }
+    }
+}
+
+void *collector(void *arg) {
+    (void)arg;
+    struct timespec period = { 0, 1000000 };
+    while (atomic_load(&collecting)) {
+        drain_rings();
+        nanosleep(&period, NULL);
+    }
+    drain_rings();
+    return NULL;
+}
+
+void start_trace(void) {
+    memset(sstats, 0, sizeof(sstats));
+    memset(handoff_hist, 0, sizeof(handoff_hist));
+    memset(posts, 0, sizeof(posts));
+    nhandoff = 0;
+    trace_begin = trace_now();
+    for (int i = 0; i < nsmoker; i++) sstats[i].last_wake = trace_begin;
+    atomic_store(&collecting, 1);
+    if (pthread_create(&collector_thread, NULL, collector, NULL) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// end是生产者做完最后一轮的时刻，不含之后收拾吸烟者和汇总线程的时间
+void stop_trace(uint64_t end) {
+    atomic_store(&collecting, 0);
+    pthread_join(collector_thread, NULL);
+    trace_end = end;
+    // 最后一次轮到之后一直没有再轮到，也算作间隔
+    for (int i = 0; i < nsmoker; i++)
+        if (trace_end - sstats[i].last_wake > sstats[i].max_gap) sstats[i].max_gap = trace_end - sstats[i].last_wake;
+}
+
+// 各吸烟者相对其公平份额（他那种材料被留下的轮数除以同种吸烟者的人数）的服务量的Jain指数，1表示完全公平
+double jain_index(void) {
+    double sum = 0, sq = 0;
+    int n = 0;
+    for (int i = 0; i < nsmoker; i++) {
+        int k = i % ningredient, group = nsmoker / ningredient + (k < nsmoker % ningredient);
+        if (posts[k] == 0) continue;
+        double x = sstats[i].served / ((double)posts[k] / group);
+        sum += x;
+        sq += x * x;
+        n++;
+    }
+    return n && sq > 0 ? sum * sum / (n * sq) : 1;
+}
+
+uint64_t max_gap(void) {
+    uint64_t g = 0;
+    for (int i = 0; i < nsmoker; i++)
+        if (sstats[i].max_gap > g) g = sstats[i].max_gap;
+    return g;
+}
+
+uint64_t dropped_events(void) {
+    uint64_t d = 0;
+    for (int a = 0; a <= nsmoker; a++) d += atomic_load(&tr->rings[a].dropped);
+    return d;
+}
+
+void print_trace(void) {
+    printf("handoff latency (us): rounds=%llu p50=%.2f p90=%.2f p99=%.2f max=%.2f\n",
+           (unsigned long long)nhandoff, hist_percentile(handoff_hist, nhandoff, 0.5) / 1e3,
+           hist_percentile(handoff_hist, nhandoff, 0.9) / 1e3, hist_percentile(handoff_hist, nhandoff, 0.99) / 1e3,
+           hist_percentile(handoff_hist, nhandoff, 1.0) / 1e3);
+    printf("fairness: jain=%.4f longest starvation=%.3f ms dropped events=%llu\n", jain_index(), max_gap() / 1e6,
+           (unsigned long long)dropped_events());
+    printf("smoker,ingredient,served,fair_share,max_gap_ms,mean_handoff_us\n");
+    for (int i = 0; i < nsmoker; i++) {
+        int k = i % ningredient, group = nsmoker / ningredient + (k < nsmoker % ningredient);
+        struct smoker_stats *st = &sstats[i];
+        printf("%d,%s,%llu,%.1f,%.3f,%.2f\n", i, ingredient_name(k), (unsigned long long)st->served,
+               (double)posts[k] / group, st->max_gap / 1e6, st->served ? st->handoff_sum / 1e3 / st->served : 0.0);
+    }
+}
 
-    // 父进程作为生产者
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// report为真时在结果行之后输出完整的记录报告，否则（-B）只在行尾加几列
+void run_rounds(int header, int report) {
+    start_smokers();
+    if (tracing) start_trace();
+    double begin = now_seconds();
+    producer();
+    double seconds = now_seconds() - begin;
+    uint64_t end = trace_now();
+    stop_smokers();
+    if (header) {
+        printf("mode,ingredients,smokers,rounds,seconds,rounds_per_s");
+        if (tracing && !report) printf(",handoff_p50_us,handoff_p99_us,jain,max_gap_ms");
+        printf("\n");
+    }
+    printf("%s,%d,%d,%ld,%.3f,%.0f", mode_names[mode], ningredient, nsmoker, rounds, seconds, rounds / seconds);
+    if (tracing) {
+        stop_trace(end);
+        if (!report)
+            printf(",%.2f,%.2f,%.4f,%.3f", hist_percentile(handoff_hist, nhandoff, 0.5) / 1e3,
+                   hist_percentile(handoff_hist, nhandoff, 0.99) / 1e3, jain_index(), max_gap() / 1e6);
+    }
+    printf("\n");
+    if (tracing) {
+        if (report) print_trace();
+        munmap(tr, tr_bytes);
+    }
+    fflush(stdout);
+}
+
+// 两种模式下吸烟者从ningredient个倍增到max_smoker个时的每秒轮数
+void benchmark(int max_smoker) {
+    for (int m = 0; m < NMODE; m++) {
+        mode = m;
+        for (nsmoker = ningredient;; nsmoker *= 2) {
+            if (nsmoker > max_smoker) nsmoker = max_smoker;
+            run_rounds(m == 0 && nsmoker == ningredient, 0);
+            if (nsmoker == max_smoker) break;
+        }
+    }
+}
+
+void usage(const char *prog) {
+    printf("Usage: %s [-m mode] [-i ingredients] [-s smokers] [-t us]             一直运行，打印过程\n"
+           "       %s [-m mode] [-i ingredients] [-s smokers] [-t us] [-T] -r rounds 跑rounds轮，输出每秒轮数\n"
+           "       %s [-i ingredients] [-s max_smokers] [-t us] [-T] -B rounds   两种模式下吸烟者倍增时的每秒轮数\n"
+           "  -m mode         sem（默认，子进程加一个信号量集）或futex（线程，按位唤醒）\n"
+           "  -i ingredients  材料种类数，默认3，最多%d\n"
+           "  -s smokers      吸烟者人数，至少和材料种类一样多，默认与材料种类相同，最多%d；-B时默认为材料种类的8倍\n"
+           "  -t us           每支烟抽多少微秒，默认2000000，-r和-B时默认0\n"
+           "  -T              记录每轮的事件，报告交接延迟、各吸烟者的服务次数和最长等待间隔，只用于-r和-B\n",
+           prog, prog, prog, MAX_INGREDIENTS, MAX_SMOKERS);
+}
+
+int main(int argc, char *argv[]) {
+    long bench = 0;
+    int smokers = 0;
+    long smoke = -1;
+    init_ingredient_names();
+    for (int c; (c = getopt(argc, argv, "m:i:s:t:r:B:Th")) != -1;) {
+        switch (c) {
+        case 'm':
+            if (strcmp(optarg, "sem") == 0) mode = MODE_SEM;
+            else if (strcmp(optarg, "futex") == 0) mode = MODE_FUTEX;
+            else {
+                fprintf(stderr, "unknown mode: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'i': ningredient = atoi(optarg); break;
+        case 's': smokers = atoi(optarg); break;
+        case 't': smoke = atol(optarg); break;
+        case 'r': rounds = atol(optarg); break;
+        case 'B': bench = atol(optarg); break;
+        case 'T': tracing = 1; break;
+        default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    nsmoker = smokers ? smokers : bench ? 8 * ningredient : ningredient;
+    if (nsmoker > MAX_SMOKERS) nsmoker = MAX_SMOKERS;
+    if (optind != argc || ningredient < 2 || ningredient > MAX_INGREDIENTS || nsmoker < ningredient
+        || rounds < 0 || bench < 0 || (tracing && !rounds && !bench)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    smoke_us = smoke >= 0 ? smoke : rounds || bench ? 0 : 2000000;
+
+    // 注册信号处理
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+
+    if (bench) {
+        rounds = bench;
+        benchmark(nsmoker);
+        return 0;
+    }
+    if (rounds) {
+        run_rounds(1, 1);
+        return 0;
+    }
+
+    // 父进程作为生产者，永远不会返回
+    start_smokers();
     producer();
 
     // 永远不会执行到这里，保持代码完整性
-    cleanup();
+    stop_smokers();
     return 0;
-}
\ No newline at end of file
+}
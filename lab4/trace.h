@@ -0,0 +1,83 @@
+// 轻量的事件记录：每个执行者（生产者、各吸烟者）一个单写者环形缓冲区，记带时间戳的事件。
+// 写入只有几次普通存储和一次release，缓冲区满了就丢弃并计数，不会阻塞；
+// 由汇总线程在旁边定期取走，统计都不在热路径上。缓冲区在fork之前用MAP_SHARED映射
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_RING 4096     // 每个缓冲区的事件数，必须是2的幂
+
+enum { EV_POST, EV_WAKE, EV_DONE };
+
+struct trace_event {
+    uint64_t ns;            // CLOCK_MONOTONIC，跨进程可比
+    uint64_t value;         // POST：留下的材料；WAKE：交接延迟；DONE：未用
+    uint32_t round;
+    uint16_t type, actor;
+};
+
+// tail只由写者推进，head只由汇总线程推进，各占一个缓存行
+struct trace_ring {
+    _Atomic uint64_t tail;
+    char pad1[56];
+    _Atomic uint64_t head;
+    char pad2[56];
+    _Atomic uint64_t dropped;
+    char pad3[56];
+    struct trace_event ev[TRACE_RING];
+};
+
+static inline uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void trace_emit(struct trace_ring *r, int type, int actor, uint32_t round, uint64_t value,
+                              uint64_t ns) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&r->head, memory_order_acquire) == TRACE_RING) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    r->ev[tail & (TRACE_RING - 1)] = (struct trace_event) { ns, value, round, type, actor };
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+// 取出一个事件，没有时返回0。只能由汇总线程调用
+static inline int trace_take(struct trace_ring *r, struct trace_event *e) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (atomic_load_explicit(&r->tail, memory_order_acquire) == head) return 0;
+    *e = r->ev[head & (TRACE_RING - 1)];
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return 1;
+}
+
+// 延迟的直方图：小于16ns的每个值一格，之后每个2的幂区间再分8格，相对误差不超过1/8
+#define HIST_BUCKETS 496
+
+static inline int hist_bucket(uint64_t v) {
+    if (v < 16) return v;
+    int msb = 63 - __builtin_clzll(v);
+    return (msb - 3) * 8 + (v >> (msb - 3));
+}
+
+static inline uint64_t bucket_value(int b) {
+    if (b < 16) return b;
+    int msb = b / 8 + 2;
+    return (uint64_t)(b % 8 + 8) << (msb - 3);
+}
+
+// 直方图里第p分位的值（所在格子的下界）
+static inline uint64_t hist_percentile(const uint64_t *hist, uint64_t n, double p) {
+    if (n == 0) return 0;
+    uint64_t rank = (uint64_t)(p * (n - 1)), seen = 0;
+    int b = 0;
+    for (; b < HIST_BUCKETS && (seen += hist[b]) <= rank; b++) {}
+    return bucket_value(b);
+}
+
+#endif
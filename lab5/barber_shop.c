@@ -6,41 +6,226 @@
 #include <sys/wait.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 
-#define NUM_BARBER 3
-#define NUM_ROOM 20
-#define NUM_SOFA 4
+#include "mpmc_queue.h"
+#include "shop_sim.h"
+
+#define MAX_BARBER 64
 #define SIZE_NAME 20
 
+// 理发师人数、沙发座位数、等候室容量，可以用-c修改
+int nbarber = 3;
+int nsofa = 4;
+int nroom = 20;
+
 #define MSQ_ROOM 1
 #define MSQ_SOFA 2
 
+// 顾客队列的实现：msg是System V消息队列加沙发管理进程，
+// queue是共享内存里的一个有界队列，前nsofa个位置就是沙发，理发师直接从队头取人
+enum { BACKEND_MSG, BACKEND_QUEUE, NBACKEND };
+const char *backend_names[NBACKEND] = { "msg", "queue" };
+int backend = BACKEND_MSG;
+
 int msqid;
 int semid;
+struct mpmc_queue *shop;  // queue后端：等候室和沙发上的顾客，按到达顺序排队
 
 // 信号量操作辅助宏
-#define SEM_OP(id, op)                           \
+#define SEM_OP_FLG(id, op, flg)                  \
     do {                                         \
-        struct sembuf sb = {id, (op), SEM_UNDO}; \
+        struct sembuf sb = {id, (op), (flg)};    \
         if (semop(semid, &sb, 1) == -1) {       \
             perror("semop");                     \
             exit(EXIT_FAILURE);                  \
         }                                        \
     } while (0)
+#define SEM_OP(id, op) SEM_OP_FLG(id, op, SEM_UNDO)
+// 沙发和等候室的名额在一个进程里占用、在另一个进程里归还，不能用SEM_UNDO：
+// 每个进程的调整值只增不减，压测几万位顾客后就会超出上限（ERANGE）
+#define SEM_PASS(id, op) SEM_OP_FLG(id, op, 0)
 
 #define SEM_ROOM 0
 #define SEM_SOFA 1
 #define SEM_ACCOUNTBOOK 2
 
+// 名字为空的顾客是压测结束的标记
+struct customer {
+    char name[SIZE_NAME];
+    uint64_t arrive_ns;     // 进门的时刻，理发师接待时算出排队时间
+};
+
 struct msgbuf {
     long mtype;
-    char mtext[SIZE_NAME];
+    struct customer c;
+};
+
+// 压测模式：不打印、不睡眠，顾客满了就等着而不是离开，统计每位顾客从进门到被理发师接待的时间
+long load = 0;
+
+// 排队时间的直方图：小于16ns的每个值一格，之后每个2的幂区间再分8格，相对误差不超过1/8
+#define HIST_BUCKETS 496
+
+// 每个理发师一份，放在共享内存里，各占各的缓存行
+struct barber_stats {
+    uint64_t served;
+    uint64_t hist[HIST_BUCKETS];
+    char pad[56];
+};
+struct barber_stats *stats;
+
+int hist_bucket(uint64_t v) {
+    if (v < 16) return v;
+    int msb = 63 - __builtin_clzll(v);
+    return (msb - 3) * 8 + (v >> (msb - 3));
+}
+
+uint64_t bucket_value(int b) {
+    if (b < 16) return b;
+    int msb = b / 8 + 2;
+    return (uint64_t)(b % 8 + 8) << (msb - 3);
+}
+
+// 账本：global是所有理发师共用一本，每笔都在SEM_ACCOUNTBOOK里记；
+// sharded是每个理发师先无锁地记在自己的分账上，攒够LEDGER_FLUSH笔或有人要看总账时再并入总账
+enum { BOOK_GLOBAL, BOOK_SHARDED, NBOOK };
+const char *book_names[NBOOK] = { "global", "sharded" };
+int book_mode = BOOK_GLOBAL;
+
+#define PRICE 30
+#define LEDGER_SIZE 256     // 每本分账最多暂存的笔数，必须是2的幂
+#define LEDGER_FLUSH 64
+
+struct transaction {
+    uint32_t barber, amount;
+    uint64_t time_ns;
+};
+
+// 单写者的环形分账：理发师只写tail，合并的一方持有账本时推进head。两端各占一个缓存行，
+// 分账之间也不共享缓存行，理发师记账时互不干扰
+struct ledger {
+    _Atomic uint64_t tail;
+    char pad1[56];
+    _Atomic uint64_t head;
+    char pad2[56];
+    struct transaction entries[LEDGER_SIZE];
 };
 
+struct accountbook {
+    uint64_t transactions, revenue;
+    uint64_t last_ns;                   // 最近一笔的时间
+    uint64_t per_barber[MAX_BARBER];    // 每个理发师的笔数
+};
+
+// 总账和各理发师的分账，放在共享内存里
+struct book_region {
+    struct accountbook book;
+    struct ledger ledgers[];
+};
+struct book_region *books;
+
+void book_apply(const struct transaction *t) {
+    books->book.transactions++;
+    books->book.revenue += t->amount;
+    books->book.per_barber[t->barber]++;
+    if (t->time_ns > books->book.last_ns) books->book.last_ns = t->time_ns;
+}
+
+// 把一本分账上还没并入的笔数记进总账，调用时必须持有账本
+void ledger_merge(struct ledger *l) {
+    uint64_t head = atomic_load_explicit(&l->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&l->tail, memory_order_acquire);
+    for (; head != tail; head++) book_apply(&l->entries[head & (LEDGER_SIZE - 1)]);
+    atomic_store_explicit(&l->head, head, memory_order_release);
+}
+
+void ledger_flush(struct ledger *l) {
+    SEM_OP(SEM_ACCOUNTBOOK, -1);
+    ledger_merge(l);
+    SEM_OP(SEM_ACCOUNTBOOK, 1);
+}
+
+// 记一笔：global直接记进总账；sharded追加到自己的分账，只在攒够一批时才去拿账本
+void book_record(int id, const struct transaction *t) {
+    if (book_mode == BOOK_GLOBAL) {
+        SEM_OP(SEM_ACCOUNTBOOK, -1);
+        book_apply(t);
+        SEM_OP(SEM_ACCOUNTBOOK, 1);
+        return;
+    }
+    struct ledger *l = &books->ledgers[id];
+    uint64_t tail = atomic_load_explicit(&l->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&l->head, memory_order_acquire) == LEDGER_SIZE) ledger_flush(l);
+    l->entries[tail & (LEDGER_SIZE - 1)] = *t;
+    atomic_store_explicit(&l->tail, tail + 1, memory_order_release);
+    if (tail + 1 - atomic_load_explicit(&l->head, memory_order_acquire) >= LEDGER_FLUSH) ledger_flush(l);
+}
+
+// 按需合并：把所有分账并入总账后返回总账的一份快照
+struct accountbook book_snapshot(void) {
+    SEM_OP(SEM_ACCOUNTBOOK, -1);
+    for (int i = 0; i < nbarber; i++) ledger_merge(&books->ledgers[i]);
+    struct accountbook b = books->book;
+    SEM_OP(SEM_ACCOUNTBOOK, 1);
+    return b;
+}
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 int keep_running = 1;
-pid_t children[NUM_BARBER + 2];  // 3理发师 + sofa进程 + 主进程分支
+#ifdef USE_THREADS
+pthread_t children[MAX_BARBER + 1];  // 理发师 + sofa线程
+#else
+pid_t children[MAX_BARBER + 2];  // 理发师 + sofa进程 + 主进程分支
+#endif
 int child_count = 0;
 
+// 理发师和沙发管理者在多进程版里是子进程，在线程版里是线程
+void spawn(void *(*fn)(void *), void *arg) {
+#ifdef USE_THREADS
+    if (pthread_create(&children[child_count++], NULL, fn, arg) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+#else
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        // 清理由父进程负责，子进程收到信号直接退出
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        fn(arg);
+        exit(EXIT_SUCCESS);
+    }
+    children[child_count++] = pid;
+#endif
+}
+
+void join_all(void) {
+    for (int i = 0; i < child_count; i++) {
+#ifdef USE_THREADS
+        pthread_join(children[i], NULL);
+#else
+        waitpid(children[i], NULL, 0);
+#endif
+    }
+    child_count = 0;
+}
+
 void cleanup() {
     msgctl(msqid, IPC_RMID, NULL);
     semctl(semid, 0, IPC_RMID);
@@ -48,71 +233,496 @@ void cleanup() {
 
 void sigint_handler(int sig) {
     keep_running = 0;
-    // 清理流程
+    // 清理流程（线程随进程一起退出）
+#ifndef USE_THREADS
     for (int i = 0; i < child_count; i++) {
         printf("killing %d\n",children[i]);
         kill(children[i], 9);
         waitpid(children[i], NULL, 0);
     }
+#endif
     cleanup();
     exit(0);
 }
 
-int barber(char *name) {
+// 取下一位顾客，没人时睡觉。压测结束时返回0
+int next_customer(const char *name, struct customer *c) {
+    if (backend == BACKEND_QUEUE) {
+        uint64_t pos;
+        if (!queue_try_pop(shop, c, &pos)) {
+            if (!load) printf("%s is sleeping.\n", name);
+            if (!queue_pop(shop, c, &pos)) return 0;
+        }
+        // 这位顾客离开沙发，排在沙发后面第一位的人坐上沙发
+        struct customer next;
+        if (!load && queue_peek(shop, pos + nsofa, &next)) printf("%s sits on the sofa.\n", next.name);
+        return 1;
+    }
     struct msgbuf customer;
-    while (1) {
-        if (msgrcv(msqid, &customer, sizeof(customer.mtext), MSQ_SOFA, IPC_NOWAIT) == -1) {
-            printf("%s is sleeping.\n", name);
-            msgrcv(msqid, &customer, sizeof(customer.mtext), MSQ_SOFA, 0);
+    if (msgrcv(msqid, &customer, sizeof(customer.c), MSQ_SOFA, IPC_NOWAIT) == -1) {
+        if (!load) printf("%s is sleeping.\n", name);
+        msgrcv(msqid, &customer, sizeof(customer.c), MSQ_SOFA, 0);
+    }
+    SEM_PASS(SEM_SOFA, 1);
+    *c = customer.c;
+    return c->name[0] != 0;
+}
+
+void *barber(void *arg) {
+    int id = (intptr_t)arg;
+    char name[SIZE_NAME];
+    snprintf(name, sizeof(name), "Tony%d", id + 1);
+    struct barber_stats *st = &stats[id];
+    struct customer customer;
+    while (next_customer(name, &customer)) {
+        if (load) {
+            uint64_t wait = now_ns() - customer.arrive_ns;
+            st->hist[hist_bucket(wait)]++;
+            st->served++;
+            struct transaction t = { id, PRICE, now_ns() };
+            book_record(id, &t);
+            continue;
         }
-        SEM_OP(SEM_SOFA, 1);
-        printf("%s is giving %s a haircut.\n", name, customer.mtext);
+        printf("%s is giving %s a haircut.\n", name, customer.name);
         sleep(10);
+        struct transaction t = { id, PRICE, now_ns() };
+        if (book_mode == BOOK_SHARDED) {
+            // 记在自己的分账上，不用等别人
+            printf("%s is writing in own ledger.\n", name);
+            sleep(1);
+            book_record(id, &t);
+            continue;
+        }
         SEM_OP(SEM_ACCOUNTBOOK, -1);
         printf("%s is using accountbook.\n", name);
         sleep(1);
+        book_apply(&t);
         SEM_OP(SEM_ACCOUNTBOOK, 1);
     }
+    return NULL;
 }
 
-int main() {
-    printf("pid:%d\n",getpid());
- 
-    // 创建IPC资源
+// msg后端的沙发管理者：有空沙发时把等候室里的顾客请到沙发上。转交完每个理发师的结束标记后退出
+void *sofa_manager(void *arg) {
+    (void)arg;
+    struct msgbuf customer;
+    int ended = 0;
+    while (ended < nbarber) {
+        msgrcv(msqid, &customer, sizeof(customer.c), MSQ_ROOM, 0);
+        SEM_PASS(SEM_SOFA, -1);
+        SEM_PASS(SEM_ROOM, 1);
+        customer.mtype = MSQ_SOFA;
+        if (customer.c.name[0] == 0) ended++;
+        else if (!load) printf("%s sits on the sofa.\n", customer.c.name);
+        msgsnd(msqid, &customer, sizeof(customer.c), 0);
+    }
+    return NULL;
+}
+
+// 顾客进门，等候室满了就离开（返回0）。wait为真时改为等到有空位
+int arrive(const struct customer *c, int wait) {
+    if (backend == BACKEND_QUEUE) {
+        uint64_t pos;
+        if (wait) queue_push(shop, c, &pos);
+        else if (!queue_try_push(shop, c, &pos)) return 0;
+        // 前面排着的人不到nsofa个，直接坐上沙发
+        if (!load) {
+            if (pos - atomic_load(&shop->head) < nsofa) printf("%s sits on the sofa.\n", c->name);
+            else printf("%s is in the waiting room.\n", c->name);
+        }
+        return 1;
+    }
+    struct sembuf sb = {SEM_ROOM, -1, wait ? 0 : IPC_NOWAIT};
+    if (semop(semid, &sb, 1) == -1) return 0;
+    struct msgbuf customer = { MSQ_ROOM, *c };
+    if (!load && c->name[0]) printf("%s is in the waiting room.\n", c->name);
+    msgsnd(msqid, &customer, sizeof(customer.c), 0);
+    return 1;
+}
+
+// 创建IPC资源，启动理发师（msg后端还有沙发管理者）
+void open_shop(void) {
     msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0666);
     semid = semget(IPC_PRIVATE, 3, IPC_CREAT | 0666);
+    if (msqid == -1 || semid == -1) {
+        perror("ipc");
+        exit(EXIT_FAILURE);
+    }
 
-    semctl(semid, SEM_ROOM, SETVAL, NUM_ROOM);
-    semctl(semid, SEM_SOFA, SETVAL, NUM_SOFA);
-    SEM_OP(SEM_ACCOUNTBOOK, 1);
+    semctl(semid, SEM_ROOM, SETVAL, nroom);
+    semctl(semid, SEM_SOFA, SETVAL, nsofa);
+    semctl(semid, SEM_ACCOUNTBOOK, SETVAL, 1);
+    if (backend == BACKEND_QUEUE) shop = queue_create(nroom + nsofa, sizeof(struct customer));
+    memset(stats, 0, sizeof(struct barber_stats) * nbarber);
+    memset(books, 0, sizeof(struct book_region) + sizeof(struct ledger) * nbarber);
+
+    // 子进程不要再输出父进程缓冲区里的内容
+    fflush(stdout);
+    for (int i = 0; i < nbarber; i++) spawn(barber, (void *)(intptr_t)i);
+    if (backend == BACKEND_MSG) spawn(sofa_manager, NULL);
+}
 
-    // 创建理发师进程
-    for (int i = 0; i < NUM_BARBER; i++) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            char name[] = { 'T','o','n','y', '1'+i, 0};
-            barber(name);
-            exit(EXIT_SUCCESS);
+// 让每个理发师都收到结束标记，等他们下班，然后释放资源
+void close_shop(void) {
+    if (backend == BACKEND_QUEUE) {
+        queue_close(shop);
+    } else {
+        struct customer end = { "" };
+        for (int i = 0; i < nbarber; i++) arrive(&end, 1);
+    }
+    join_all();
+    if (backend == BACKEND_QUEUE) queue_destroy(shop);
+    // 分账上最后不满一批的几笔
+    struct accountbook b = book_snapshot();
+    if (!load) printf("accountbook: %llu haircuts, revenue %llu.\n", (unsigned long long)b.transactions,
+                      (unsigned long long)b.revenue);
+    cleanup();
+}
+
+// 压测：count位顾客一个接一个进门，统计吞吐和排队时间的分位数
+void run_load(long count, int header) {
+    open_shop();
+    // 压测被中断（Ctrl-C、timeout）时也要删掉消息队列和信号量
+    signal(SIGINT, sigint_handler);
+    signal(SIGTERM, sigint_handler);
+    uint64_t begin = now_ns();
+    struct customer c = { "c" };
+    for (long i = 0; i < count; i++) {
+        c.arrive_ns = now_ns();
+        arrive(&c, 1);
+    }
+    close_shop();
+    double seconds = (now_ns() - begin) / 1e9;
+    if (books->book.transactions != (uint64_t)count || books->book.revenue != (uint64_t)count * PRICE)
+        fprintf(stderr, "accountbook mismatch: %llu transactions for %ld customers\n",
+                (unsigned long long)books->book.transactions, count);
+
+    uint64_t hist[HIST_BUCKETS] = { 0 }, served = 0;
+    for (int i = 0; i < nbarber; i++) {
+        served += stats[i].served;
+        for (int b = 0; b < HIST_BUCKETS; b++) hist[b] += stats[i].hist[b];
+    }
+    double p[] = { 0.5, 0.9, 0.99, 1.0 };
+    double us[4] = { 0 };
+    for (int k = 0, b = 0; k < 4 && served > 0; k++) {
+        uint64_t rank = (uint64_t)(p[k] * (served - 1)), seen = 0;
+        for (b = 0; b < HIST_BUCKETS && (seen += hist[b]) <= rank; b++) {}
+        us[k] = bucket_value(b) / 1e3;
+    }
+    if (header) printf("backend,book,barbers,customers,seconds,customers_per_s,p50_us,p90_us,p99_us,max_us\n");
+    printf("%s,%s,%d,%llu,%.3f,%.0f,%.2f,%.2f,%.2f,%.2f\n", backend_names[backend], book_names[book_mode], nbarber,
+           (unsigned long long)served, seconds, served / seconds, us[0], us[1], us[2], us[3]);
+    fflush(stdout);
+}
+
+// 两种账本在不同理发师人数下的吞吐：人数取1、2、4……直到-c给出的人数。
+// 理发不花时间，每位顾客都要记一笔，账本是否成为瓶颈最明显
+void book_benchmark(long count) {
+    int max_barber = nbarber;
+    for (int m = 0; m < NBOOK; m++) {
+        book_mode = m;
+        for (int b = 1;; b *= 2) {
+            nbarber = b < max_barber ? b : max_barber;
+            run_load(count, m == 0 && b == 1);
+            if (nbarber == max_barber) break;
         }
-        children[child_count++] = pid;
-    }
-
-    // 创建沙发管理进程
-    pid_t sofa_pid = fork();
-    if (sofa_pid == 0) {
-        struct msgbuf customer;
-        while (1) {
-            msgrcv(msqid, &customer, sizeof(customer.mtext), MSQ_ROOM, 0);
-            SEM_OP(SEM_SOFA, -1);
-            SEM_OP(SEM_ROOM, 1);
-            customer.mtype = MSQ_SOFA;
-            printf("%s sits on the sofa.\n", customer.mtext);
-            msgsnd(msqid, &customer, sizeof(customer.mtext), 0);
+    }
+    nbarber = max_barber;
+}
+
+// 离散事件模拟的配置，理发时间和记账时间的默认值与真实流程里的sleep一致
+struct sim_config sim = {
+    .arrival = { DIST_EXP, 4, 0 },
+    .haircut = { DIST_CONST, 10, 0 },
+    .book = { DIST_CONST, 1, 0 },
+    .seed = 1,
+};
+
+void run_sim(void) {
+    sim.nbarber = nbarber;
+    sim.sharded_book = book_mode == BOOK_SHARDED;
+    sim.nsofa = nsofa;
+    sim.nroom = nroom;
+    struct sim_result r;
+    uint64_t begin = now_ns();
+    simulate(&sim, &r);
+    double seconds = (now_ns() - begin) / 1e9;
+    printf("%d barbers, %d sofa seats, %d room: %ld customers, %ld served, %ld balked (%.2f%%)\n", nbarber, nsofa,
+           nroom, sim.customers, r.served, r.balked, 100.0 * r.balked / sim.customers);
+    printf("wait: mean=%.3f p50=%.3f p90=%.3f p99=%.3f max=%.3f\n", r.wait_mean, r.wait_p50, r.wait_p90,
+           r.wait_p99, r.wait_max);
+    printf("accountbook: busy=%.1f%% waits=%ld (%.2f%% of haircuts) mean=%.3f p99=%.3f max=%.3f\n",
+           100 * r.book_busy, r.book_waits, r.served ? 100.0 * r.book_waits / r.served : 0.0, r.book_wait_mean,
+           r.book_wait_p99, r.book_wait_max);
+    printf("barbers: busy=%.1f%% blocked on accountbook=%.2f%%\n", 100 * r.barber_busy, 100 * r.blocked);
+    printf("simulated %.1f time units in %.3f s (%.0f customers/s)\n", r.duration, seconds,
+           sim.customers / seconds);
+}
+
+// 参数扫描：网格里的每个(理发师, 沙发, 等候室)组合各跑一次独立的模拟，
+// 由jobs个子进程（线程版里是线程）从共享的计数器上领取，结果写回共享内存
+struct range {
+    int lo, hi, step;
+};
+struct range grid[3] = { { 1, 8, 1 }, { 0, 8, 2 }, { 0, 32, 4 } };  // 理发师、沙发、等候室
+double unit_cost[3] = { 100, 5, 1 };    // 每个理发师、沙发座位、等候室位置的成本
+double slo = -1;                        // p99等待时间的上限，小于0表示不限
+double max_balk = 0.01;                 // 离开的顾客超过这个比例的组合不参与比较
+int jobs = 0;
+
+struct sweep_cell {
+    int size[3];
+    double cost;
+    struct sim_result r;
+};
+
+struct sweep {
+    _Atomic long next;                  // 下一个要模拟的格子
+    long ncell;
+    struct sweep_cell cells[];
+};
+struct sweep *sw;
+
+void *sweep_worker(void *arg) {
+    (void)arg;
+    struct sim_config cfg = sim;
+    for (long i; (i = atomic_fetch_add(&sw->next, 1)) < sw->ncell;) {
+        struct sweep_cell *c = &sw->cells[i];
+        cfg.nbarber = c->size[0];
+        cfg.nsofa = c->size[1];
+        cfg.nroom = c->size[2];
+        simulate(&cfg, &c->r);
+    }
+    return NULL;
+}
+
+int parse_range(const char *s, struct range *r) {
+    r->step = 1;
+    int n = sscanf(s, "%d:%d:%d", &r->lo, &r->hi, &r->step);
+    if (n == 1) r->hi = r->lo;
+    return n >= 1 && r->lo >= 0 && r->lo <= r->hi && r->step > 0;
+}
+
+// 按成本、再按p99排序，依次扫过去，p99比之前所有组合都低的就在帕累托前沿上
+int compare_cell(const void *a, const void *b) {
+    const struct sweep_cell *x = a, *y = b;
+    if (x->cost != y->cost) return x->cost < y->cost ? -1 : 1;
+    return compare_double(&x->r.wait_p99, &y->r.wait_p99);
+}
+
+void run_sweep(void) {
+    long ncell = 1;
+    for (int d = 0; d < 3; d++) ncell *= (grid[d].hi - grid[d].lo) / grid[d].step + 1;
+    size_t bytes = sizeof(struct sweep) + sizeof(struct sweep_cell) * ncell;
+    sw = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sw == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    sw->ncell = 0;
+    for (int b = grid[0].lo; b <= grid[0].hi; b += grid[0].step) {
+        for (int so = grid[1].lo; so <= grid[1].hi; so += grid[1].step) {
+            for (int ro = grid[2].lo; ro <= grid[2].hi; ro += grid[2].step) {
+                struct sweep_cell *c = &sw->cells[sw->ncell++];
+                *c = (struct sweep_cell) { { b, so, ro } };
+                for (int d = 0; d < 3; d++) c->cost += unit_cost[d] * c->size[d];
+            }
         }
-    } else {
-        children[child_count++] = sofa_pid;
     }
 
+    // 各子进程从sim拷贝配置，-l要在spawn之前设进去
+    sim.sharded_book = book_mode == BOOK_SHARDED;
+    if (jobs <= 0) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > ncell) jobs = ncell;
+    if (jobs > MAX_BARBER) jobs = MAX_BARBER;
+    uint64_t begin = now_ns();
+    fflush(stdout);
+    for (int j = 0; j < jobs; j++) spawn(sweep_worker, NULL);
+    join_all();
+    double seconds = (now_ns() - begin) / 1e9;
+
+    qsort(sw->cells, ncell, sizeof(struct sweep_cell), compare_cell);
+    printf("barbers,sofa,room,cost,p99_wait,mean_wait,balk_pct,meets_slo\n");
+    const struct sweep_cell *cheapest = NULL;
+    double best = INFINITY;
+    for (long i = 0; i < ncell; i++) {
+        const struct sweep_cell *c = &sw->cells[i];
+        if (c->r.balked > max_balk * sim.customers || c->r.wait_p99 >= best) continue;
+        best = c->r.wait_p99;
+        int meets = slo < 0 || c->r.wait_p99 <= slo;
+        if (meets && !cheapest) cheapest = c;
+        printf("%d,%d,%d,%.0f,%.3f,%.3f,%.3f,%d\n", c->size[0], c->size[1], c->size[2], c->cost, c->r.wait_p99,
+               c->r.wait_mean, 100.0 * c->r.balked / sim.customers, meets);
+    }
+    fprintf(stderr, "%ld configurations x %ld customers in %.3f s with %d jobs\n", ncell, sim.customers, seconds,
+            jobs);
+    if (slo >= 0) {
+        if (cheapest)
+            fprintf(stderr, "cheapest meeting p99 <= %g: %d barbers, %d sofa seats, %d room (cost %.0f)\n", slo,
+                    cheapest->size[0], cheapest->size[1], cheapest->size[2], cheapest->cost);
+        else fprintf(stderr, "no configuration in the grid meets p99 <= %g\n", slo);
+    }
+    munmap(sw, bytes);
+}
+
+void usage(const char *prog) {
+    printf("Usage: %s [-c sizes] [-q backend]            从标准输入读入顾客的名字\n"
+           "       %s [-c sizes] [-q backend] -n count   压测：count位顾客尽快进门，输出吞吐和排队时间\n"
+           "       %s [-c sizes] [-q backend] -B count   两种账本在1、2、4……个理发师下的压测吞吐，默认用queue\n"
+           "       %s [-c sizes] -S count [-a dist] [-s dist] [-k dist] [-r seed]\n"
+           "                                            离散事件模拟count位顾客，输出等待时间分位数、离开率和账本争用\n"
+           "  -c b,s,r    理发师人数、沙发座位数、等候室容量，默认3,4,20，理发师最多%d个\n"
+           "  -q backend  msg（默认，消息队列加沙发管理进程）或queue（共享内存队列，futex等待）；\n"
+           "              压测时不指定则两种都测\n"
+           "  -l book     global（默认，所有理发师共用一本账，每笔都要拿账本）或sharded（各记各的分账，成批并入总账）\n"
+           "  -a dist     顾客到达间隔，默认exp:4\n"
+           "  -s dist     理发时间，默认const:10\n"
+           "  -k dist     记账时间，默认const:1\n"
+           "              分布为const:v、exp:mean、uniform:lo:hi或lognormal:mean:sd\n"
+           "  -r seed     随机数种子，默认1\n"
+           "       %s -G b,s,r -S count [-a dist] [-s dist] [-k dist] [-r seed] [-C cb,cs,cr] [-W slo] [-L balk] [-j jobs]\n"
+           "                                            并行扫描网格里的每种配置，输出成本与p99等待时间的帕累托前沿\n"
+           "  -G b,s,r    理发师、沙发、等候室的取值范围，每项为lo[:hi[:step]]，默认1:8,0:8:2,0:32:4\n"
+           "  -C cb,cs,cr 每个理发师、沙发座位、等候室位置的成本，默认100,5,1\n"
+           "  -W slo      p99等待时间的目标，给出时报告满足目标的最便宜配置\n"
+           "  -L balk     离开率超过balk（默认0.01）的配置不参与比较\n"
+           "  -j jobs     并行的子进程数，默认为CPU数\n",
+           prog, prog, prog, prog, MAX_BARBER, prog);
+}
+
+// 后端能不能用当前的沙发和等候室大小开店，不能时返回原因
+const char *shop_size_error(int b) {
+    // 队列的容量为nsofa + nroom，Vyukov的序号至少要两个槽才分得清空和满
+    if (b == BACKEND_QUEUE && nsofa + nroom < 2) return "needs at least 2 sofa seats and room places in total";
+    // 沙发管理者要先占一个沙发座位才去等候室叫人，结束标记也要占等候室的名额，否则都会永远等下去
+    if (b == BACKEND_MSG && (nsofa < 1 || nroom < 1)) return "needs at least 1 sofa seat and 1 room place";
+    return NULL;
+}
+
+void parse_dist_arg(const char *s, struct dist *d) {
+    if (!parse_dist(s, d)) {
+        fprintf(stderr, "bad distribution: %s\n", s);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int chosen = -1, sweep = 0;
+    long bench = 0;
+    for (int c; (c = getopt(argc, argv, "c:q:n:B:l:S:a:s:k:r:G:C:W:L:j:h")) != -1;) {
+        switch (c) {
+        case 'c':
+            if (sscanf(optarg, "%d,%d,%d", &nbarber, &nsofa, &nroom) != 3) {
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'q':
+            for (int b = 0; b < NBACKEND; b++)
+                if (strcmp(optarg, backend_names[b]) == 0) chosen = b;
+            if (chosen < 0) {
+                fprintf(stderr, "unknown backend: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'n': load = atol(optarg); break;
+        case 'B': bench = atol(optarg); break;
+        case 'l':
+            if (strcmp(optarg, "global") == 0) book_mode = BOOK_GLOBAL;
+            else if (strcmp(optarg, "sharded") == 0) book_mode = BOOK_SHARDED;
+            else {
+                fprintf(stderr, "unknown accountbook: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'S': sim.customers = atol(optarg); break;
+        case 'a': parse_dist_arg(optarg, &sim.arrival); break;
+        case 's': parse_dist_arg(optarg, &sim.haircut); break;
+        case 'k': parse_dist_arg(optarg, &sim.book); break;
+        case 'r': sim.seed = strtoull(optarg, NULL, 0); break;
+        case 'G': {
+            char *spec[3] = { strtok(optarg, ","), strtok(NULL, ","), strtok(NULL, ",") };
+            for (int d = 0; d < 3; d++) {
+                if (!spec[d] || !parse_range(spec[d], &grid[d]) || (d == 0 && grid[d].lo < 1)) {
+                    fprintf(stderr, "bad grid: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            sweep = 1;
+            break;
+        }
+        case 'C':
+            if (sscanf(optarg, "%lf,%lf,%lf", &unit_cost[0], &unit_cost[1], &unit_cost[2]) != 3) {
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'W': slo = atof(optarg); break;
+        case 'L': max_balk = atof(optarg); break;
+        case 'j': jobs = atoi(optarg); break;
+        default: usage(argv[0]); exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc || load < 0 || bench < 0 || sim.customers < 0 || nbarber < 1 || nbarber > MAX_BARBER || nsofa < 0
+        || nroom < 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (sweep && sim.customers == 0) {
+        fprintf(stderr, "-G needs -S count\n");
+        exit(EXIT_FAILURE);
+    }
+    if (sweep) {
+        run_sweep();
+        return 0;
+    }
+    if (sim.customers) {
+        run_sim();
+        return 0;
+    }
+
+    // 模拟和扫描的大小可以是0，真正开店时要检查用到的每个后端
+    int used = chosen >= 0 ? 1 << chosen : bench ? 1 << BACKEND_QUEUE : load ? (1 << NBACKEND) - 1 : 1 << BACKEND_MSG;
+    for (int b = 0; b < NBACKEND; b++) {
+        const char *err = used >> b & 1 ? shop_size_error(b) : NULL;
+        if (err) {
+            fprintf(stderr, "%s backend: %s\n", backend_names[b], err);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    stats = mmap(NULL, sizeof(struct barber_stats) * nbarber, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    books = mmap(NULL, sizeof(struct book_region) + sizeof(struct ledger) * nbarber, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (books == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+
+    if (bench) {
+        load = bench;
+        backend = chosen >= 0 ? chosen : BACKEND_QUEUE;
+        book_benchmark(bench);
+        return 0;
+    }
+    if (load) {
+        for (int b = 0; b < NBACKEND; b++) {
+            if (chosen >= 0 && b != chosen) continue;
+            backend = b;
+            run_load(load, chosen < 0 ? b == 0 : 1);
+        }
+        return 0;
+    }
+
+    printf("pid:%d\n",getpid());
+    if (chosen >= 0) backend = chosen;
+    open_shop();
+
     // 使用 signal() 设置信号处理
     if (signal(SIGINT, sigint_handler) == SIG_ERR) {
         perror("signal");
@@ -120,18 +730,13 @@ int main() {
     }
 
     // 主进程处理客户输入
-    struct msgbuf customer;
-    struct sembuf sb = {SEM_ROOM, -1, IPC_NOWAIT};
-    while (keep_running) {
-        scanf("%s", customer.mtext);
-        if (semop(semid, &sb, 1) != -1) {
-            customer.mtype = MSQ_ROOM;
-            printf("%s is in the waiting room.\n", customer.mtext);
-            msgsnd(msqid, &customer, sizeof(customer.mtext), 0);
-        } else {
-            printf("Waiting room is full, %s leaves.\n", customer.mtext);
-        }
+    struct customer customer = { "" };
+    while (keep_running && scanf("%19s", customer.name) == 1) {
+        customer.arrive_ns = now_ns();
+        if (!arrive(&customer, 0)) printf("Waiting room is full, %s leaves.\n", customer.name);
     }
 
+    // 输入结束：剩下的顾客理完再关门
+    close_shop();
     return 0;
 }
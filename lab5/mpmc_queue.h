@@ -0,0 +1,168 @@
+// 共享内存上的有界多生产者多消费者队列，空/满时用futex等待
+// 每个槽带一个序号（Vyukov的算法）：序号等于pos表示槽空、可以写入第pos个元素，
+// 等于pos+1表示第pos个元素已写好、可以读出。入队出队各只需一次CAS，不用锁
+// 队列在fork之前用MAP_SHARED映射，父子进程和同一进程的线程都能用
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define QUEUE_SPIN 128   // 睡眠之前先自旋检查的次数
+
+// head和tail只增不减，对cap取模后才是槽的位置；分在不同的缓存行上，生产者和消费者互不干扰
+// pushed/popped是futex字，每次入队/出队加一；*_waiting是睡在上面的数量，不为0时才需要futex_wake
+struct mpmc_queue {
+    _Atomic uint64_t head;          // 下一个要出队的位置
+    char pad1[56];
+    _Atomic uint64_t tail;          // 下一个要入队的位置
+    char pad2[56];
+    _Atomic uint32_t pushed, push_waiting;  // 等非空的一方
+    _Atomic uint32_t popped, pop_waiting;   // 等非满的一方
+    _Atomic uint32_t closed;        // 不会再有入队
+    uint32_t cap, item_size, stride;
+    char pad3[32];
+    char slots[];                   // 每个槽是一个序号加item_size字节的元素，占stride字节
+};
+
+static inline void queue_futex_wait(_Atomic uint32_t *addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+static inline void queue_futex_wake(_Atomic uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// 计数加一之后再看有没有人在等。与等待方先登记、再复查条件配对，不会丢失唤醒
+static inline void queue_notify(_Atomic uint32_t *seq, _Atomic uint32_t *waiting) {
+    atomic_fetch_add(seq, 1);
+    if (atomic_load(waiting)) queue_futex_wake(seq);
+}
+
+static inline _Atomic uint64_t *slot_seq(struct mpmc_queue *q, uint64_t pos) {
+    return (_Atomic uint64_t *)(q->slots + (pos % q->cap) * q->stride);
+}
+static inline void *slot_item(struct mpmc_queue *q, uint64_t pos) {
+    return q->slots + (pos % q->cap) * q->stride + sizeof(uint64_t);
+}
+
+// 映射一个容量为cap、元素大小为item_size的队列。
+// cap为1时槽的空（序号pos+1）和满（序号pos+1）分不开，至少取2
+static inline struct mpmc_queue *queue_create(uint32_t cap, uint32_t item_size) {
+    if (cap < 2) cap = 2;
+    uint32_t stride = (sizeof(uint64_t) + item_size + 7) & ~7u;
+    struct mpmc_queue *q = mmap(NULL, sizeof(struct mpmc_queue) + (size_t)cap * stride, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (q == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    q->cap = cap;
+    q->item_size = item_size;
+    q->stride = stride;
+    for (uint32_t i = 0; i < cap; i++) atomic_init(slot_seq(q, i), i);
+    return q;
+}
+
+static inline void queue_destroy(struct mpmc_queue *q) {
+    munmap(q, sizeof(struct mpmc_queue) + (size_t)q->cap * q->stride);
+}
+
+// 入队，队满返回0。成功时*pos是元素的位置，pos - head就是它前面排着的人数
+static inline int queue_try_push(struct mpmc_queue *q, const void *item, uint64_t *pos) {
+    uint64_t p = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    for (;;) {
+        _Atomic uint64_t *seq = slot_seq(q, p);
+        int64_t diff = (int64_t)(atomic_load_explicit(seq, memory_order_acquire) - p);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &p, p + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                memcpy(slot_item(q, p), item, q->item_size);
+                atomic_store_explicit(seq, p + 1, memory_order_release);
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;   // 这个槽上一轮的元素还没被取走
+        } else {
+            p = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+    if (pos) *pos = p;
+    queue_notify(&q->pushed, &q->push_waiting);
+    return 1;
+}
+
+// 出队，队空返回0
+static inline int queue_try_pop(struct mpmc_queue *q, void *item, uint64_t *pos) {
+    uint64_t p = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        _Atomic uint64_t *seq = slot_seq(q, p);
+        int64_t diff = (int64_t)(atomic_load_explicit(seq, memory_order_acquire) - (p + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &p, p + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                memcpy(item, slot_item(q, p), q->item_size);
+                atomic_store_explicit(seq, p + q->cap, memory_order_release);
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            p = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    if (pos) *pos = p;
+    queue_notify(&q->popped, &q->pop_waiting);
+    return 1;
+}
+
+// 读出第pos个元素但不出队，它还没入队或已经被取走时返回0
+// 复制前后各检查一次序号，复制期间被取走、槽被下一轮覆盖的情况都能发现
+static inline int queue_peek(struct mpmc_queue *q, uint64_t pos, void *item) {
+    _Atomic uint64_t *seq = slot_seq(q, pos);
+    if (atomic_load_explicit(seq, memory_order_acquire) != pos + 1) return 0;
+    memcpy(item, slot_item(q, pos), q->item_size);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(seq, memory_order_relaxed) == pos + 1
+        && atomic_load_explicit(&q->head, memory_order_acquire) <= pos;
+}
+
+// 入队，队满时等到有空位。取s之后有人出队的话popped已变，futex_wait会立即返回
+static inline void queue_push(struct mpmc_queue *q, const void *item, uint64_t *pos) {
+    for (int i = 0;; i++) {
+        uint32_t s = atomic_load(&q->popped);
+        if (queue_try_push(q, item, pos)) return;
+        if (i < QUEUE_SPIN) continue;
+        atomic_fetch_add(&q->pop_waiting, 1);
+        queue_futex_wait(&q->popped, s);
+        atomic_fetch_sub(&q->pop_waiting, 1);
+    }
+}
+
+// 出队，队空时等待。队列关闭且已取空时返回0
+static inline int queue_pop(struct mpmc_queue *q, void *item, uint64_t *pos) {
+    for (int i = 0;; i++) {
+        uint32_t s = atomic_load(&q->pushed);
+        if (queue_try_pop(q, item, pos)) return 1;
+        if (atomic_load(&q->closed)) return queue_try_pop(q, item, pos);
+        if (i < QUEUE_SPIN) continue;
+        atomic_fetch_add(&q->push_waiting, 1);
+        queue_futex_wait(&q->pushed, s);
+        atomic_fetch_sub(&q->push_waiting, 1);
+    }
+}
+
+// 关闭队列，叫醒所有等待出队的一方
+static inline void queue_close(struct mpmc_queue *q) {
+    atomic_store(&q->closed, 1);
+    queue_notify(&q->pushed, &q->push_waiting);
+}
+
+#endif
@@ -0,0 +1,237 @@
+// 理发店的离散事件模拟：与barber_shop的真实流程相同（等候室→沙发→理发师→账本），
+// 但在虚拟时间里推进，到达间隔、理发时间、记账时间都按给定的分布抽样，不睡眠也不用IPC。
+// 一次模拟的全部状态都在参数和局部变量里，可以在多个进程或线程里同时跑
+#ifndef SHOP_SIM_H
+#define SHOP_SIM_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { DIST_CONST, DIST_EXP, DIST_UNIFORM, DIST_LOGNORMAL };
+
+// const:v，exp:mean，uniform:lo:hi，lognormal:mean:sd
+struct dist {
+    int kind;
+    double a, b;    // lognormal时是对数的均值和标准差
+};
+
+struct sim_config {
+    int nbarber, nsofa, nroom;
+    struct dist arrival, haircut, book;   // 到达间隔、理发时间、记账时间
+    long customers;
+    uint64_t seed;
+    int sharded_book;                     // 各理发师记自己的分账，记账不用排队
+};
+
+struct sim_result {
+    long served, balked;
+    double wait_mean, wait_p50, wait_p90, wait_p99, wait_max;  // 进门到开始理发
+    long book_waits;                    // 理完发时账本被占用、需要等的次数
+    double book_wait_mean, book_wait_p99, book_wait_max;       // 只统计需要等的那些
+    double book_busy, barber_busy;      // 账本和理发师（含等账本）的利用率，分账时为各分账的平均利用率
+    double blocked;                     // 理发师等账本的时间占其总时间的比例
+    double duration;                    // 最后一个事件的虚拟时间
+};
+
+// 解析分布，格式不对返回0
+static inline int parse_dist(const char *s, struct dist *d) {
+    double a = 0, b = 0;
+    if (sscanf(s, "const:%lf", &a) == 1 && a >= 0) *d = (struct dist) { DIST_CONST, a, 0 };
+    else if (sscanf(s, "exp:%lf", &a) == 1 && a > 0) *d = (struct dist) { DIST_EXP, a, 0 };
+    else if (sscanf(s, "uniform:%lf:%lf", &a, &b) == 2 && 0 <= a && a <= b) *d = (struct dist) { DIST_UNIFORM, a, b };
+    else if (sscanf(s, "lognormal:%lf:%lf", &a, &b) == 2 && a > 0 && b >= 0) {
+        double sigma2 = log(1 + b * b / (a * a));
+        *d = (struct dist) { DIST_LOGNORMAL, log(a) - sigma2 / 2, sqrt(sigma2) };
+    } else return 0;
+    return 1;
+}
+
+// splitmix64，每次模拟一个独立的状态
+static inline uint64_t sim_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// (0, 1)上的均匀分布
+static inline double sim_uniform(uint64_t *state) {
+    return ((sim_next(state) >> 11) + 0.5) * 0x1p-53;
+}
+
+static inline double sample(const struct dist *d, uint64_t *state) {
+    switch (d->kind) {
+    case DIST_EXP: return -d->a * log(sim_uniform(state));
+    case DIST_UNIFORM: return d->a + (d->b - d->a) * sim_uniform(state);
+    case DIST_LOGNORMAL: {
+        double n = sqrt(-2 * log(sim_uniform(state))) * cos(2 * M_PI * sim_uniform(state));
+        return exp(d->a + d->b * n);
+    }
+    default: return d->a;
+    }
+}
+
+enum { EV_ARRIVAL, EV_HAIRCUT_DONE, EV_BOOK_DONE };
+
+struct event {
+    double time;
+    int type, barber;
+};
+
+// 按时间排序的二叉堆。任何时刻每个理发师最多一个事件，再加一个下一位顾客的到达
+struct event_heap {
+    struct event *e;
+    int n;
+};
+
+static inline void heap_push(struct event_heap *h, struct event ev) {
+    int i = h->n++;
+    for (; i > 0 && h->e[(i - 1) / 2].time > ev.time; i = (i - 1) / 2) h->e[i] = h->e[(i - 1) / 2];
+    h->e[i] = ev;
+}
+
+static inline struct event heap_pop(struct event_heap *h) {
+    struct event top = h->e[0], last = h->e[--h->n];
+    int i = 0;
+    for (int c; (c = 2 * i + 1) < h->n; i = c) {
+        if (c + 1 < h->n && h->e[c + 1].time < h->e[c].time) c++;
+        if (last.time <= h->e[c].time) break;
+        h->e[i] = h->e[c];
+    }
+    h->e[i] = last;
+    return top;
+}
+
+static inline int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static inline double percentile(const double *sorted, long n, double p) {
+    return n > 0 ? sorted[(long)(p * (n - 1))] : 0;
+}
+
+static inline void *sim_alloc(size_t n) {
+    void *p = malloc(n ? n : 1);
+    if (!p) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// 模拟cfg->customers位顾客。等候室满了（等候室nroom人，沙发也坐满）的顾客离开；
+// 理发师按到达顺序从沙发上叫人，理完发去记账，账本被占用就排队等
+static void simulate(const struct sim_config *cfg, struct sim_result *r) {
+    int cap = cfg->nsofa + cfg->nroom;
+    uint64_t rng = cfg->seed;
+    struct event_heap heap = { sim_alloc(sizeof(struct event) * (cfg->nbarber + 1)), 0 };
+    double *waiting = sim_alloc(sizeof(double) * cap);             // 排队顾客的到达时间，环形
+    int *idle = sim_alloc(sizeof(int) * cfg->nbarber);             // 空闲的理发师
+    int *book_queue = sim_alloc(sizeof(int) * cfg->nbarber);       // 等账本的理发师，环形
+    double *book_since = sim_alloc(sizeof(double) * cfg->nbarber); // 各理发师开始等账本的时刻
+    double *waits = sim_alloc(sizeof(double) * cfg->customers);
+    double *book_waits = sim_alloc(sizeof(double) * cfg->customers);
+    int nwaiting = 0, wait_head = 0, nidle = cfg->nbarber, nbook = 0, book_head = 0, book_held = 0;
+    long arrived = 1;
+    double busy = 0, book_busy = 0, blocked = 0, now = 0;
+
+    memset(r, 0, sizeof(*r));
+    for (int b = 0; b < cfg->nbarber; b++) idle[b] = cfg->nbarber - 1 - b;
+    heap_push(&heap, (struct event) { sample(&cfg->arrival, &rng), EV_ARRIVAL, -1 });
+
+    // 理发师b从now开始为在arrive时刻进门的顾客理发
+    #define START_HAIRCUT(b, arrive)                                                 \
+        do {                                                                         \
+            double cut = sample(&cfg->haircut, &rng);                                \
+            waits[r->served++] = now - (arrive);                                     \
+            busy += cut;                                                             \
+            heap_push(&heap, (struct event) { now + cut, EV_HAIRCUT_DONE, (b) });    \
+        } while (0)
+    #define START_BOOK(b)                                                            \
+        do {                                                                         \
+            double hold = sample(&cfg->book, &rng);                                  \
+            book_held = !cfg->sharded_book;                                          \
+            busy += hold;                                                            \
+            book_busy += hold;                                                       \
+            heap_push(&heap, (struct event) { now + hold, EV_BOOK_DONE, (b) });      \
+        } while (0)
+
+    while (heap.n > 0) {
+        struct event ev = heap_pop(&heap);
+        now = ev.time;
+        int b = ev.barber;
+        switch (ev.type) {
+        case EV_ARRIVAL:
+            if (arrived++ < cfg->customers)
+                heap_push(&heap, (struct event) { now + sample(&cfg->arrival, &rng), EV_ARRIVAL, -1 });
+            if (nidle > 0) START_HAIRCUT(idle[--nidle], now);
+            else if (nwaiting < cap) waiting[(wait_head + nwaiting++) % cap] = now;
+            else r->balked++;
+            break;
+        case EV_HAIRCUT_DONE:
+            if (!book_held) {
+                START_BOOK(b);
+            } else {
+                book_since[b] = now;
+                book_queue[(book_head + nbook++) % cfg->nbarber] = b;
+            }
+            break;
+        case EV_BOOK_DONE:
+            book_held = 0;
+            if (nbook > 0) {
+                int next = book_queue[book_head];
+                book_head = (book_head + 1) % cfg->nbarber;
+                nbook--;
+                double w = now - book_since[next];
+                book_waits[r->book_waits++] = w;
+                blocked += w;
+                busy += w;
+                START_BOOK(next);
+            }
+            if (nwaiting > 0) {
+                double arrive = waiting[wait_head];
+                wait_head = (wait_head + 1) % cap;
+                nwaiting--;
+                START_HAIRCUT(b, arrive);
+            } else {
+                idle[nidle++] = b;
+            }
+            break;
+        }
+    }
+    #undef START_HAIRCUT
+    #undef START_BOOK
+
+    r->duration = now;
+    double total = 0;
+    for (long i = 0; i < r->served; i++) total += waits[i];
+    qsort(waits, r->served, sizeof(double), compare_double);
+    r->wait_mean = r->served ? total / r->served : 0;
+    r->wait_p50 = percentile(waits, r->served, 0.5);
+    r->wait_p90 = percentile(waits, r->served, 0.9);
+    r->wait_p99 = percentile(waits, r->served, 0.99);
+    r->wait_max = percentile(waits, r->served, 1.0);
+    qsort(book_waits, r->book_waits, sizeof(double), compare_double);
+    r->book_wait_mean = r->book_waits ? blocked / r->book_waits : 0;
+    r->book_wait_p99 = percentile(book_waits, r->book_waits, 0.99);
+    r->book_wait_max = percentile(book_waits, r->book_waits, 1.0);
+    if (now > 0) {
+        r->book_busy = book_busy / (cfg->sharded_book ? now * cfg->nbarber : now);
+        r->barber_busy = busy / (now * cfg->nbarber);
+        r->blocked = blocked / (now * cfg->nbarber);
+    }
+
+    free(heap.e);
+    free(waiting);
+    free(idle);
+    free(book_queue);
+    free(book_since);
+    free(waits);
+    free(book_waits);
+}
+
+#endif
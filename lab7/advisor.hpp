@@ -0,0 +1,191 @@
+// 在线置换算法顾问：运行中的服务分批推入访问，随时查询最近一段访问上的缺页率、
+// 工作集大小，以及换成其他算法/页框数时的缺页率（what-if），可以嵌入缓存做影子模拟
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "replacer.hpp"
+#include "mrc.hpp"
+
+// 可在线运行的算法（OPT要预知未来，不在其中）
+using OnlinePolicy = std::variant<Fifo, Lru, Lfu, LfuAging, Clock, EnhancedClock, Arc, TwoQ, Lirs, ClockPro>;
+
+struct AdvisorConfig {
+    std::uint64_t epoch = 1 << 16;  // 每个统计周期的访问数，查询窗口以周期为粒度
+    int history = 16;               // 保留的周期数（含当前周期），可查询的最长窗口约为 epoch*(history-1)
+    double rate = 1.0;              // 影子模拟按SHARDS做空间采样的比例，见StackDistance
+    IoCost cost;
+};
+
+struct WhatIf {
+    std::string policy;
+    int nframe;
+    double faults, writebacks;      // 采样时已按1/rate放大
+    double miss_ratio, stall_ms;
+};
+
+struct AdvisorReport {
+    std::uint64_t accesses;         // 窗口内的访问数
+    double working_set;             // 窗口内访问过的不同页数（估计值）
+    std::vector<WhatIf> what_if;    // 与add()的顺序相同
+};
+
+// 访问按周期记账，每个周期在环形数组里占一格：周期开始时记下累计的访问数和各影子的累计缺页数，
+// 窗口内的计数就是当前累计值减去窗口起点那一格的记录。
+// 工作集用HyperLogLog估计，每个周期一组寄存器，查询时按位取max合并窗口内的各周期。
+// 内存只与周期数、影子数和各影子的页框数有关，与推入的访问总数无关
+class Advisor {
+    static constexpr int HLL_BITS = 12;
+    static constexpr size_t HLL_M = size_t(1) << HLL_BITS;
+    static constexpr std::uint64_t MODULUS = 1 << 24;
+    static constexpr size_t BATCH = 4096;   // 采样访问攒够这么多就交给影子，缓冲区大小有界
+
+    struct shadow_t {
+        std::string policy;
+        int nframe;
+        OnlinePolicy state;
+        Status<> status;
+        std::vector<long long> fault_marks, writeback_marks;  // 每个周期开始时的累计值
+    };
+
+    AdvisorConfig cfg;
+    std::uint64_t threshold;
+    std::vector<shadow_t> shadows;
+    std::vector<std::uint8_t> registers;        // 第k格周期的寄存器占 [k*HLL_M, (k+1)*HLL_M)
+    std::vector<std::uint64_t> access_marks;    // 每个周期开始时的累计访问数
+    std::uint64_t n_access = 0, n_epoch = 1;    // n_epoch：已开始的周期数，当前周期在第 (n_epoch-1)%history 格
+    std::vector<access_t> sampled;              // 当前周期里还没交给影子的采样访问
+
+    size_t slot() const { return (n_epoch - 1) % cfg.history; }
+
+    // 采样的访问交给各影子，每个影子只在这里分派一次算法类型
+    void flush() {
+        for (auto& s : shadows) {
+            std::visit([&](auto& policy) {
+                for (auto [p, write] : sampled) {
+                    s.status.access(p, write);
+                    policy.access(p, s.status);
+                }
+            }, s.state);
+        }
+        sampled.clear();
+    }
+
+    void mark(shadow_t& s) {
+        s.fault_marks[slot()] = s.status.faults();
+        s.writeback_marks[slot()] = s.status.writebacks();
+    }
+
+    void roll() {
+        flush();
+        n_epoch++;
+        access_marks[slot()] = n_access;
+        std::fill_n(registers.begin() + slot() * HLL_M, HLL_M, 0);
+        for (auto& s : shadows) mark(s);
+    }
+
+    // 多个周期的寄存器合并后的基数估计，小基数时用线性计数修正
+    static double estimate(const std::uint8_t* reg) {
+        double sum = 0;
+        int zeros = 0;
+        for (size_t i = 0; i < HLL_M; i++) {
+            sum += std::ldexp(1.0, -reg[i]);
+            zeros += reg[i] == 0;
+        }
+        double m = HLL_M;
+        double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        if (e <= 2.5 * m && zeros > 0) e = m * std::log(m / zeros);
+        return e;
+    }
+
+public:
+    explicit Advisor(AdvisorConfig cfg = {})
+        : cfg(cfg), threshold(static_cast<std::uint64_t>(cfg.rate * MODULUS)),
+          registers(HLL_M * cfg.history), access_marks(cfg.history) {}
+
+    // 增加一个影子：算法policy在nframe个页框下的模拟。采样时实际模拟 nframe*rate 个页框。
+    // 算法未知或为opt时返回false。应在push()之前调用，否则影子只看到之后的访问
+    bool add(std::string_view policy, int nframe) {
+        if (nframe <= 0) return false;
+        int scaled = std::max<long long>(std::llround(nframe * cfg.rate), 1);
+        bool ok = false;
+        visit_policy(policy, [&]<typename Policy>() {
+            if constexpr (!std::is_same_v<Policy, Opt>) {
+                auto& s = shadows.emplace_back(shadow_t {
+                    std::string(policy), nframe, OnlinePolicy(std::in_place_type<Policy>, scaled), {},
+                    std::vector<long long>(cfg.history), std::vector<long long>(cfg.history),
+                });
+                s.status.cost = cfg.cost;
+                s.status.start(scaled);
+                mark(s);
+                ok = true;
+            }
+        });
+        return ok;
+    }
+
+    // 推入一批访问，元素为page或access_t
+    template<typename Batch>
+    void push(const Batch& batch) {
+        for (auto a : batch) {
+            auto [p, write] = to_access(a);
+            std::uint64_t h = page_hash(p);
+            std::uint8_t rank = std::countl_zero(h << HLL_BITS | (std::uint64_t(1) << (HLL_BITS - 1))) + 1;
+            std::uint8_t& reg = registers[slot() * HLL_M + (h >> (64 - HLL_BITS))];
+            reg = std::max(reg, rank);
+            if (cfg.rate >= 1.0 || h % MODULUS < threshold) {
+                sampled.push_back({ p, write });
+                if (sampled.size() == BATCH) flush();
+            }
+            if (++n_access - access_marks[slot()] == cfg.epoch) roll();
+        }
+        flush();
+    }
+
+    std::uint64_t accesses() const { return n_access; }
+
+    // 最近window次访问上的统计。窗口从当前周期向前按整个周期扩展，直到覆盖window次访问，
+    // 或用完保留的周期，所以实际窗口（report.accesses）可能比window略大或更小
+    AdvisorReport query(std::uint64_t window) const {
+        int k = 1;
+        int max_k = std::min<std::uint64_t>(n_epoch, cfg.history);
+        auto start = [&](int k) { return (n_epoch - k) % cfg.history; };
+        while (k < max_k && n_access - access_marks[start(k)] < window) k++;
+
+        AdvisorReport report;
+        report.accesses = n_access - access_marks[start(k)];
+        std::vector<std::uint8_t> merged(HLL_M, 0);
+        for (int j = 1; j <= k; j++) {
+            const std::uint8_t* reg = &registers[start(j) * HLL_M];
+            for (size_t i = 0; i < HLL_M; i++) merged[i] = std::max(merged[i], reg[i]);
+        }
+        report.working_set = report.accesses ? estimate(merged.data()) : 0;
+
+        for (const auto& s : shadows) {
+            double faults = (s.status.faults() - s.fault_marks[start(k)]) / cfg.rate;
+            double writebacks = (s.status.writebacks() - s.writeback_marks[start(k)]) / cfg.rate;
+            report.what_if.push_back({
+                s.policy, s.nframe, faults, writebacks,
+                report.accesses ? faults / report.accesses : 0.0,
+                (faults * cfg.cost.read_us + writebacks * cfg.cost.write_us) / 1000,
+            });
+        }
+        return report;
+    }
+};
+
+// 每个影子一行，at为查询时的累计访问数
+inline void print_advisor(std::uint64_t at, const AdvisorReport& r, bool header, FILE* out = stdout) {
+    if (header) fprintf(out, "at,window,working_set,policy,frames,faults,miss_ratio,writebacks,stall_ms\n");
+    for (const auto& w : r.what_if)
+        fprintf(out, "%llu,%llu,%.0f,%s,%d,%.0f,%.6f,%.0f,%.3f\n", (unsigned long long)at,
+                (unsigned long long)r.accesses, r.working_set, w.policy.c_str(), w.nframe, w.faults, w.miss_ratio,
+                w.writebacks, w.stall_ms);
+}
@@ -0,0 +1,302 @@
+// 模拟器本身的性能基准：每个 负载 × 算法 × 页框数 测一次
+// 输出每次访问的耗时、吞吐、峰值内存和每次访问的堆分配次数，可以与保存的基线比较
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <span>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "replacer.hpp"
+#include "workload.hpp"
+
+// 统计堆分配次数，替换全局的operator new，包括对齐的（FrameTable等）和nothrow的版本。
+// delete不内联，免得编译器看到new出来的指针被free而误报不匹配
+static std::atomic<long long> n_alloc { 0 };
+
+static void* counted_alloc(size_t size, size_t align) {
+    n_alloc.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    // aligned_alloc要求大小是对齐的整数倍
+    return align <= alignof(std::max_align_t) ? malloc(size) : aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+static void* counted_new(size_t size, size_t align) {
+    if (void* p = counted_alloc(size, align)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] static void counted_free(void* p) noexcept { free(p); }
+
+void* operator new(size_t size) { return counted_new(size, 0); }
+void* operator new[](size_t size) { return counted_new(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return counted_new(size, size_t(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return counted_new(size, size_t(al)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, size_t(al));
+}
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, size_t(al));
+}
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+
+// 标准负载，长度由 -N 决定，各阶段不够长时循环
+static const struct {
+    const char* name;
+    const char* spec;
+} WORKLOADS[] = {
+    { "zipf", "zipf:pages=1e6,s=0.9" },
+    { "loop", "loop:pages=2e4" },
+    { "shift", "shift:pages=5000,period=1e5,step=1000,w=0.2" },
+    { "mixed", "zipf:pages=1e5,s=0.8,len=2e5,w=0.3+scan:len=5e4+loop:pages=8000,len=1e5,w=0.5" },
+};
+
+struct Result {
+    double seconds;      // reps次中最快的一次
+    long long allocs;    // 一次模拟中的堆分配次数
+    long rss_kb;         // 模拟过程中RSS峰值比开始时多出的部分
+};
+
+struct Row {
+    std::string workload, policy;
+    int nframe;
+    long long accesses;
+    double ns;
+    double allocs;
+    long rss_kb;
+};
+
+static long current_rss_kb() {
+    long size, resident;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f || fscanf(f, "%ld %ld", &size, &resident) != 2) {
+        perror("/proc/self/statm");
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 在子进程中测量一个格子，峰值内存和分配次数不受其他格子影响
+static Result measure(const std::string& policy, int nframe, const vector<access_t>& trace, int reps) {
+    int fd[2];
+    if (pipe(fd) == -1) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        Result res { 1e300, 0, 0 };
+        long rss_start = current_rss_kb();
+        visit_policy(policy, [&]<typename Policy>() {
+            for (int i = 0; i < reps; i++) {
+                PageReplacer<std::span<const access_t>> vmpr {
+                    .nframe = nframe,
+                    .access_seq = trace
+                };
+                long long allocs = n_alloc.load(std::memory_order_relaxed);
+                auto begin = std::chrono::steady_clock::now();
+                vmpr.template simulate<Policy>();
+                double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                res.seconds = std::min(res.seconds, t);
+                res.allocs = n_alloc.load(std::memory_order_relaxed) - allocs;
+            }
+        });
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        res.rss_kb = std::max(0L, usage.ru_maxrss - rss_start);
+        if (write(fd[1], &res, sizeof(res)) != sizeof(res)) {
+            perror("write");
+            _exit(EXIT_FAILURE);
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(fd[1]);
+    Result res;
+    int status;
+    bool ok = read(fd[0], &res, sizeof(res)) == sizeof(res);
+    close(fd[0]);
+    if (waitpid(pid, &status, 0) == -1 || !ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "benchmark of %s with %d frames failed\n", policy.c_str(), nframe);
+        exit(EXIT_FAILURE);
+    }
+    return res;
+}
+
+static void print_header() {
+    printf("workload,policy,frames,accesses,ns_per_access,maccess_per_s,peak_rss_kb,allocs_per_access\n");
+}
+
+static void print_row(const Row& r) {
+    printf("%s,%s,%d,%lld,%.2f,%.2f,%ld,%.4f\n", r.workload.c_str(), r.policy.c_str(), r.nframe,
+           r.accesses, r.ns, 1e3 / r.ns, r.rss_kb, r.allocs);
+    fflush(stdout);
+}
+
+// 读入之前保存的输出作为基线，键为 (负载, 算法, 页框数)
+using Key = std::tuple<std::string, std::string, int>;
+
+static std::map<Key, Row> load_baseline(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    std::map<Key, Row> rows;
+    char line[512], workload[64], policy[64];
+    while (fgets(line, sizeof(line), f)) {
+        Row r;
+        double throughput;
+        if (sscanf(line, "%63[^,],%63[^,],%d,%lld,%lf,%lf,%ld,%lf", workload, policy, &r.nframe,
+                   &r.accesses, &r.ns, &throughput, &r.rss_kb, &r.allocs) != 8)
+            continue;  // 表头
+        r.workload = workload;
+        r.policy = policy;
+        rows[{ r.workload, r.policy, r.nframe }] = r;
+    }
+    fclose(f);
+    return rows;
+}
+
+// 与基线比较，耗时超过基线(1+threshold)倍的算作退化，返回退化的个数
+static int compare(const std::vector<Row>& rows, const std::map<Key, Row>& baseline, double threshold) {
+    int regressions = 0;
+    fprintf(stderr, "\n%-8s %-15s %7s %10s %10s %8s\n", "workload", "policy", "frames", "base_ns", "ns",
+            "ratio");
+    for (const auto& r : rows) {
+        auto it = baseline.find({ r.workload, r.policy, r.nframe });
+        if (it == baseline.end()) continue;
+        double ratio = r.ns / it->second.ns;
+        bool slower = ratio > 1 + threshold;
+        regressions += slower;
+        fprintf(stderr, "%-8s %-15s %7d %10.2f %10.2f %7.2fx%s\n", r.workload.c_str(), r.policy.c_str(),
+                r.nframe, it->second.ns, r.ns, ratio, slower ? "  REGRESSION" : "");
+    }
+    fprintf(stderr, "%d regression(s) over %.0f%%\n", regressions, threshold * 100);
+    return regressions;
+}
+
+static vector<std::string> split(const char* s) {
+    vector<std::string> items;
+    for (const char* e; *s; s = *e ? e + 1 : e) {
+        e = strchrnul(s, ',');
+        if (e != s) items.emplace_back(s, e);
+    }
+    return items;
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [-N count] [-r reps] [-p policies] [-f frames] [-w workloads] [-c baseline [-t threshold]]\n"
+           "  -N count     每个负载的访问数，默认1e6\n"
+           "  -r reps      每个格子重复次数，取最快的一次，默认3\n"
+           "  -p list      算法，逗号分隔，默认全部\n"
+           "  -f list      页框数，逗号分隔，默认64,1024,16384\n"
+           "  -w list      负载，逗号分隔，默认全部（zipf,loop,shift,mixed）\n"
+           "  -c baseline  与之前保存的输出比较，有退化时返回非0\n"
+           "  -t threshold 比基线慢多少算退化，默认0.1\n"
+           "结果以CSV输出到标准输出，重定向到文件即可作为以后的基线\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    std::uint64_t count = 1000000;
+    int reps = 3;
+    vector<std::string> policies(std::begin(POLICY_NAMES), std::end(POLICY_NAMES));
+    vector<int> frames { 64, 1024, 16384 };
+    vector<std::string> workloads;
+    for (const auto& w : WORKLOADS) workloads.push_back(w.name);
+    const char* baseline_path = nullptr;
+    double threshold = 0.1;
+
+    for (int c; (c = getopt(argc, argv, "N:r:p:f:w:c:t:h")) != -1;) {
+        switch (c) {
+        case 'N': count = strtod(optarg, nullptr); break;
+        case 'r': reps = atoi(optarg); break;
+        case 'p': policies = split(optarg); break;
+        case 'f':
+            frames.clear();
+            for (const auto& n : split(optarg)) frames.push_back(atoi(n.c_str()));
+            break;
+        case 'w': workloads = split(optarg); break;
+        case 'c': baseline_path = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc || count == 0 || reps <= 0 || threshold < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (const auto& name : policies) {
+        if (!visit_policy(name, []<typename>() {})) {
+            fprintf(stderr, "unknown policy: %s\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    for (int n : frames) {
+        if (n <= 0) {
+            fprintf(stderr, "invalid frame count: %d\n", n);
+            return EXIT_FAILURE;
+        }
+    }
+    auto baseline = baseline_path ? load_baseline(baseline_path) : std::map<Key, Row> {};
+
+    std::vector<Row> rows;
+    print_header();
+    for (const auto& name : workloads) {
+        const char* spec = nullptr;
+        for (const auto& w : WORKLOADS)
+            if (name == w.name) spec = w.spec;
+        vector<Phase> phases;
+        if (!spec) {
+            fprintf(stderr, "unknown workload: %s\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+        parse_workload(spec, phases);
+
+        // 负载先生成到内存，计时只包含模拟本身
+        vector<access_t> trace;
+        trace.reserve(count);
+        for (access_t a : Workload(phases, count)) trace.push_back(a);
+
+        for (const auto& policy : policies) {
+            for (int n : frames) {
+                Result res = measure(policy, n, trace, reps);
+                Row r { name, policy, n, (long long)trace.size(), res.seconds * 1e9 / trace.size(),
+                        (double)res.allocs / trace.size(), res.rss_kb };
+                print_row(r);
+                rows.push_back(r);
+            }
+        }
+    }
+
+    if (baseline_path && compare(rows, baseline, threshold) > 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+// 页号 -> 页框号的索引，用于O(1)判断命中
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "trace.hpp"
+
+// 开放定址（线性探测）哈希表，容量固定为页框数两倍以上的2的幂，
+// 负载因子不超过1/2，构造后不再分配内存。删除采用回移法，不留墓碑
+class FrameIndex {
+    struct slot {
+        page key = EMPTY_PAGE;
+        std::int32_t frame = -1;
+    };
+    std::vector<slot> slots;
+    size_t mask;
+    int shift;
+
+    size_t home(page p) const {
+        // Fibonacci哈希，取乘积的高位，连续的页号也能均匀散开
+        return static_cast<size_t>(static_cast<std::uint64_t>(p) * 0x9E3779B97F4A7C15ull >> shift);
+    }
+
+public:
+    explicit FrameIndex(size_t nframe) {
+        size_t cap = 16;
+        shift = 60;
+        while (cap < 2 * nframe) cap <<= 1, shift--;
+        slots.resize(cap);
+        mask = cap - 1;
+    }
+
+    // 返回页所在的页框，不在内存中返回-1
+    int find(page p) const {
+        for (size_t i = home(p);; i = (i + 1) & mask) {
+            if (slots[i].key == p) return slots[i].frame;
+            if (slots[i].key == EMPTY_PAGE) return -1;
+        }
+    }
+
+    void insert(page p, int frame) {
+        size_t i = home(p);
+        while (slots[i].key != EMPTY_PAGE && slots[i].key != p) i = (i + 1) & mask;
+        slots[i] = { p, frame };
+    }
+
+    void erase(page p) {
+        size_t i = home(p);
+        while (slots[i].key != p) {
+            if (slots[i].key == EMPTY_PAGE) return;
+            i = (i + 1) & mask;
+        }
+        // 把后面探测链上的元素往前挪，保证查找不会在空位提前停下
+        for (size_t j = (i + 1) & mask; slots[j].key != EMPTY_PAGE; j = (j + 1) & mask) {
+            size_t h = home(slots[j].key);
+            // h不在(i, j]之间时，j处的元素可以挪到i
+            if (((j - h) & mask) >= ((j - i) & mask)) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = slot {};
+    }
+};
@@ -0,0 +1,111 @@
+// CLOCK类算法的页框表：页号数组 + 引用位/脏位位图（struct of arrays）
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if !defined(FRAME_TABLE_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#elif !defined(FRAME_TABLE_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "trace.hpp"
+
+// 在 [w, end) 中找第一个 a[k] | b[k] 不是全1的字，WithB为false时只看a，找不到返回end
+// 编译时按指令集选择一次比较4个字（AVX2）或2个字（SSE2）的实现，
+// 定义FRAME_TABLE_SCALAR时只用逐字的标量实现
+template<bool WithB>
+size_t find_not_full(const std::uint64_t* a, const std::uint64_t* b, size_t w, size_t end) {
+#if !defined(FRAME_TABLE_SCALAR) && defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    for (; w + 4 <= end; w += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w));
+        if constexpr (WithB) v = _mm256_or_si256(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w)));
+        if (!_mm256_testc_si256(v, ones)) break;
+    }
+#elif !defined(FRAME_TABLE_SCALAR) && defined(__SSE2__)
+    const __m128i ones = _mm_set1_epi64x(-1);
+    for (; w + 2 <= end; w += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + w));
+        if constexpr (WithB) v = _mm_or_si128(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + w)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, ones)) != 0xFFFF) break;
+    }
+#endif
+    for (; w < end; w++) {
+        std::uint64_t v = a[w];
+        if constexpr (WithB) v |= b[w];
+        if (~v) return w;
+    }
+    return end;
+}
+
+// 每个页框的引用位r和脏位d各占位图中的一位，时钟指针扫描时一次处理64个页框，
+// 整字全为1（都要给第二次机会）的部分再用SIMD成批跳过
+class FrameTable {
+    size_t n;
+    std::vector<page> pids;
+    std::vector<std::uint64_t> r_bits, d_bits;
+
+    static std::uint64_t bit(size_t i) { return 1ull << (i % 64); }
+
+    // 从start开始扫描，找第一个 r=0（WithD时要求 r=0且d=0）的页框，经过的页框清除r位。
+    // 扫完一整圈都没找到返回npos，此时所有r位都已清除
+    template<bool WithD>
+    size_t scan(size_t start) {
+        size_t i = start, left = n;
+        while (left > 0) {
+            // 当前字中从i开始的一段
+            size_t w = i / 64, b = i % 64;
+            size_t len = std::min({ 64 - b, left, n - i });
+            std::uint64_t seg = (len == 64 ? ~0ull : (1ull << len) - 1) << b;
+            std::uint64_t busy = r_bits[w];
+            if constexpr (WithD) busy |= d_bits[w];
+            if (std::uint64_t free = ~busy & seg) {
+                size_t pos = __builtin_ctzll(free);
+                r_bits[w] &= ~(seg & ((1ull << pos) - 1));
+                return w * 64 + pos;
+            }
+            r_bits[w] &= ~seg;
+            i += len;
+            left -= len;
+            if (i == n) i = 0;
+
+            // 对齐到字边界后，成批跳过全1的整字
+            if (i % 64 == 0 && left >= 64) {
+                size_t from = i / 64, to = std::min(n, i + left) / 64;
+                size_t stop = find_not_full<WithD>(r_bits.data(), d_bits.data(), from, to);
+                std::fill(r_bits.begin() + from, r_bits.begin() + stop, 0);
+                i += (stop - from) * 64;
+                left -= (stop - from) * 64;
+                if (i == n) i = 0;
+            }
+        }
+        return npos;
+    }
+
+public:
+    static constexpr size_t npos = -1;
+
+    explicit FrameTable(size_t nframe)
+        : n(nframe), pids(nframe, EMPTY_PAGE), r_bits((nframe + 63) / 64), d_bits((nframe + 63) / 64) {}
+
+    size_t size() const { return n; }
+    page& pid(size_t i) { return pids[i]; }
+    bool r(size_t i) const { return r_bits[i / 64] & bit(i); }
+    bool d(size_t i) const { return d_bits[i / 64] & bit(i); }
+    void set_r(size_t i, bool v) {
+        if (v) r_bits[i / 64] |= bit(i);
+        else r_bits[i / 64] &= ~bit(i);
+    }
+    void set_d(size_t i, bool v) {
+        if (v) d_bits[i / 64] |= bit(i);
+        else d_bits[i / 64] &= ~bit(i);
+    }
+
+    // 二次机会：从start开始找r=0的页框，经过的r=1的页框清除r
+    size_t find_clear_r(size_t start) { return scan<false>(start); }
+    // 增强二次机会的第一轮：找(r,d)均为0的页框，经过的页框清除r
+    size_t find_clear_rd(size_t start) { return scan<true>(start); }
+};
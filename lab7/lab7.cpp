@@ -1,244 +1,521 @@
 // 实验六：内存置换算法实验
 
-#include <vector>
 #include <ranges>
-#include <list>
-#include <map>
-#include <unordered_map>
-#include <algorithm>
-#include <cstdio>
 #include <random>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <cstring>
+#include <deque>
+#include <getopt.h>
+#include <sys/resource.h>
 
-using std::vector, 
-    std::views::iota,
-    std::find,
-    std::find_if,
-    std::ranges::generate,
-    std::list,
-    std::ranges::end,
-    std::multimap,
-    std::unordered_map;
-template<typename Range, typename T>
-bool contains(const Range& range, const T& value) {
-    return std::find(range.begin(), range.end(), value) != range.end();
-}
-using page = int;
-constexpr page EMPTY_PAGE = 0;
-
-class Status {
-    page cur;
-    int n_access, n_fault;
-    vector<page> eliminateds;
-public:
-    void access(page to) {
-        n_access += 1;
-        cur = to;
-        printf("accessing %d\n", to);
-    }
-    void fault(page victim = EMPTY_PAGE) {
-        n_fault += 1;
-        printf("%d -> %d\n", victim, cur);
-        if (victim) eliminateds.push_back(victim);
-    }
-    void report() {
-        printf("=== page fault report ==\n");
-        printf("Eliminate pages:");
-        for (page p : eliminateds) printf(" %d", p);
-        printf("\n");
-        printf("Number of page faults: %d\n", n_fault);
-        if (n_access > 0)
-            printf("Rate of page faults: %.1f%%\n", 100.0 * n_fault / n_access);
-        printf("=== report end ==\n\n");
-
-        // 清理
-        n_access = 0;
-        n_fault = 0;
-        eliminateds.clear();
-    }
-};
+#include "replacer.hpp"
+#include "mrc.hpp"
+#include "sweep.hpp"
+#include "workload.hpp"
+#include "tenants.hpp"
+#include "tlb.hpp"
+#include "advisor.hpp"
+
+using std::views::iota,
+    std::ranges::generate;
+
+static void usage(const char* prog) {
+    printf("Usage: %s                     随机序列演示\n"
+           "       %s [-b] [-s shift] [-n nframe] [-c read,write] <trace|->  所有算法一遍读完trace\n"
+           "       %s [-b] [-s shift] [-n nframe] [-c read,write] -v | -l log <trace>\n"
+           "       %s -m [-r rate] [-b] [-s shift] [-n max] <trace|->\n"
+           "       %s -S [-p policies] [-f frames] [-j threads] [-J] [-b] [-s shift] <trace|->\n"
+           "       %s -g spec [-N count] [-R seed] [-o out] [以上除trace外的选项]\n"
+           "       %s -T global|local|ws [-p policy] [-q quantum] [-W window] [-n nframe] <trace...>\n"
+           "       %s -T global|local|ws -g spec -t tenants [...]\n"
+           "       %s -P sizes [-M memory] [-L tlb] [-p policy] <trace> 或 -g spec\n"
+           "       %s -A window [-p policies] [-f frames] [-r rate] <trace|-> 或 -g spec\n"
+           "  -b        二进制trace（每次访问一个uint64，最高位表示写），默认为文本\n"
+           "  -s shift  地址右移shift位得到页号，默认0（trace中已是页号）\n"
+           "  -n nframe 物理页框数，默认6；-m时为曲线的最大页框数\n"
+           "  -c r,w    缺页读入、脏页写回各自的延迟（微秒），默认100,250\n"
+           "  -v        逐次打印每次访问和缺页（仅适合短trace）\n"
+           "  -l log    把每次访问的事件以二进制写入log，见BinaryLogSink\n"
+           "  -m        一遍扫描输出LRU在1..max个页框下的缺页数（CSV）\n"
+           "  -r rate   -m/-A时按rate比例做SHARDS采样，默认1（精确）\n"
+           "  -S        并行扫描 算法 × 页框数，输出结果矩阵（默认CSV）\n"
+           "  -p list   -S时的算法，逗号分隔，默认全部\n"
+           "  -f list   -S时的页框数，逗号分隔，默认为-n的值\n"
+           "  -j n      -S时的线程数，默认为CPU核数\n"
+           "  -J        -S时输出JSON\n"
+           "  -g spec   用合成负载代替trace，例如 zipf:pages=1e5,s=0.8,len=1e6,w=0.3+scan:len=2e5\n"
+           "            模型 uniform/zipf/shift/scan/loop，参数 len/base/pages/s/period/step/w\n"
+           "  -N count  合成负载的总访问数，默认为各阶段长度之和（不足时循环各阶段）\n"
+           "  -R seed   合成负载的随机种子，默认1\n"
+           "  -o out    把合成负载写成二进制trace后退出\n"
+           "  -T mode   多租户：每个trace是一个租户，共享nframe个页框，按租户输出结果（CSV）\n"
+           "            global 所有租户共用一个算法实例；local 页框平均分给各租户；\n"
+           "            ws 按工作集大小分配页框，租户内部LRU\n"
+           "  -t n      -T与-g同时使用时的租户数，每个租户用不同的种子生成\n"
+           "  -p policy -T时的算法（global/local），默认lru，不支持opt\n"
+           "  -q n      -T时轮转调度，每个租户一次执行n次访问；默认0，按时间戳（行首的\"时间:\"）归并\n"
+           "  -W n      -T ws时工作集的统计周期（总访问数），默认为4*nframe\n"
+           "  -P sizes  按页大小（逗号分隔，如4k,2m,1g）分别模拟两级TLB和页框置换，输出CSV\n"
+           "            trace中为虚拟地址（-s应为0），-g生成的页号按4K页换算成地址\n"
+           "  -M bytes  -P时的物理内存大小（可带k/m/g），页框数为内存/页大小，默认为nframe个4K页\n"
+           "  -L tlb    -P时的TLB，项数/路数：L1,L2[,L1大页]，默认64/4,1536/12,32/4\n"
+           "  -A n      在线顾问：分批推入访问，每n次访问查询一次最近n次访问上的工作集和\n"
+           "            各 算法 × 页框数 的缺页率（CSV），-r为影子模拟的采样率\n",
+           prog, prog, prog, prog, prog, prog, prog, prog, prog, prog);
+}
 
-struct PageReplacer {
-    Status status; 
-    int nframe;
-    vector<page> access_seq;
-    void fifo();
-    void lru();
-    void lfu();
-    void clock();
-    void enchanced_clock();
+struct Options {
+    TraceFormat format = TraceFormat::text;
+    int page_shift = 0;
+    int nframe = 6;
+    bool verbose = false;
+    const char* log_path = nullptr;
+    bool mrc = false;
+    double rate = 1.0;
+    IoCost cost;
+    bool sweep = false;
+    vector<std::string> policies;
+    vector<int> frames;
+    unsigned nthread = 0;
+    bool json = false;
+    const char* path = nullptr;
+    vector<Phase> workload;     // 非空时用合成负载代替trace
+    std::uint64_t count = 0;
+    std::uint64_t seed = 1;
+    const char* out_path = nullptr;
+    const char* tenant_mode = nullptr;  // 非空时为多租户模式
+    int ntenant = 1;
+    size_t quantum = 0;
+    std::uint64_t window = 0;
+    vector<const char*> paths;          // 多租户时每个租户一个trace
+    vector<int> page_shifts;            // 非空时模拟这些页大小下的TLB
+    std::uint64_t memory = 0;
+    TlbConfig tlb;
+    std::uint64_t advise = 0;           // 非空时为在线顾问的查询间隔
 };
 
-// FIFO算法
-void PageReplacer::fifo() {
-    vector<page> pages(nframe, EMPTY_PAGE);
-    int i = 0;
-    for (page target : access_seq) {
-        status.access(target);
-        if (contains(pages, target)) continue;
-        status.fault(pages[i]);
-        pages[i] = target;
-        i = (i + 1) % pages.size();   
-    }
-    status.report();
-}
-
-// LRU算法
-// 使用双向链表实现，哈希表优化查找时间
-void PageReplacer::lru() {
-    list<page> pages;
-    unordered_map<page, list<page>::iterator> iters;
-    for (page target : access_seq) {
-        status.access(target);
-
-        // 命中，将命中页前置
-        if (iters.contains(target)) {
-            pages.splice(pages.begin(), pages, iters[target]);
-            continue;
-        };
+// 逗号分隔的列表
+static vector<std::string> split(const char* s) {
+    vector<std::string> items;
+    for (const char* e; *s; s = *e ? e + 1 : e) {
+        e = strchrnul(s, ',');
+        if (e != s) items.emplace_back(s, e);
+    }
+    return items;
+}
 
-        // 未命中，加入target
-        pages.push_front(target);
-        iters[target] = pages.begin();
-        
-        if (pages.size() > nframe) {
-            // 如果超出frame限制，则去掉最后的
-            page victim = pages.back();
-            iters.erase(victim);
-            pages.pop_back();
-            status.fault(victim);
-        } else {
-            status.fault();
-        }
+// 带k/m/g后缀的字节数，格式错误返回0
+static std::uint64_t parse_size(const char* s) {
+    char* end;
+    std::uint64_t v = strtoull(s, &end, 0);
+    switch (*end | 0x20) {
+    case 'k': v <<= 10; end++; break;
+    case 'm': v <<= 20; end++; break;
+    case 'g': v <<= 30; end++; break;
     }
-    status.report();
+    return *end ? 0 : v;
+}
+
+// -L的参数：L1,L2[,L1大页]，每项为 项数/路数
+static bool parse_tlb(const char* s, TlbConfig& cfg) {
+    auto levels = split(s);
+    size_t* fields[][2] = {
+        { &cfg.l1_entries, &cfg.l1_ways },
+        { &cfg.l2_entries, &cfg.l2_ways },
+        { &cfg.l1_huge_entries, &cfg.l1_huge_ways },
+    };
+    if (levels.size() < 2 || levels.size() > 3) return false;
+    for (size_t i = 0; i < levels.size(); i++)
+        if (sscanf(levels[i].c_str(), "%zu/%zu", fields[i][0], fields[i][1]) != 2) return false;
+    return cfg.valid();
 }
 
-// LFU算法，替换使用频率最低的页
-void PageReplacer::lfu() {
-    multimap<int, page> pages;
-    unordered_map<page, int> counts;
+// 按选项打开trace或生成合成负载，交给f(seq)
+template<typename F>
+static auto with_source(const Options& opt, F&& f) {
+    if (!opt.workload.empty()) {
+        Workload seq(opt.workload, opt.count, opt.seed);
+        return f(seq);
+    }
+    TraceReader seq(opt.path, opt.format, opt.page_shift);
+    return f(seq);
+}
 
-    for (page target : access_seq) {
-        status.access(target);  
-        int& cnt = counts[target];
-        auto [bg, ed] = pages.equal_range(cnt);
-        auto it = find_if(bg, ed, [&target](const auto& pair) {
-            return pair.second == target;
-        });
-        if (it != ed) {
-            // 命中了，只需要删除旧的
-            pages.erase(it);
-        } else if (pages.size() < nframe) {
-            // 尚有空页
-            status.fault();
-        } else {
-            // 未命中，替换掉最少的
-            auto victim = pages.begin();
-            status.fault(victim->second);
-            pages.erase(victim);
+template<typename Sink, typename Seq>
+static void replay_all(const Options& opt, Seq& seq) {
+    PageReplacer<Seq&, Sink> vmpr {
+        .nframe = opt.nframe,
+        .access_seq = seq
+    };
+    if constexpr (std::is_same_v<Sink, BinaryLogSink>) vmpr.status.sink.open(opt.log_path);
+    vmpr.status.cost = opt.cost;
+    vmpr.fifo();
+    vmpr.lru();
+    vmpr.lfu();
+    vmpr.lfu_aging();
+    vmpr.clock();
+    vmpr.enchanced_clock();
+    vmpr.arc();
+    vmpr.two_q();
+    vmpr.lirs();
+    vmpr.clock_pro();
+    vmpr.opt();
+}
+
+// 默认的重放：所有算法在同一遍读取中按块同步推进，trace只读一次，stdin和管道也能驱动。
+// 报告的顺序和数字与replay_all逐个算法重放时相同
+template<typename Seq, typename... Policies>
+static void replay_lockstep(const Options& opt, Seq& seq) {
+    constexpr size_t N = sizeof...(Policies);
+    std::tuple<Policies...> policies { Policies(opt.nframe)... };
+    Status<> status[N + 1];     // 最后一个给OPT
+    for (auto& s : status) {
+        s.start(opt.nframe);
+        s.cost = opt.cost;
+    }
+    Belady<Status<>> opt_policy(opt.nframe, status[N]);
+
+    vector<access_t> block;
+    block.reserve(1 << 12);
+    // 一块访问依次交给每个算法，块内只碰一个算法的数据结构
+    auto feed = [&]<size_t... I>(std::index_sequence<I...>) {
+        auto run = [&](auto& policy, Status<>& s) {
+            for (access_t a : block) {
+                s.access(a.pid, a.write);
+                policy.access(a.pid, s);
+            }
+        };
+        (run(std::get<I>(policies), status[I]), ...);
+        for (access_t a : block) opt_policy.push(a);
+        block.clear();
+    };
+    for (auto a : seq) {
+        block.push_back(to_access(a));
+        if (block.size() == block.capacity()) feed(std::index_sequence_for<Policies...>());
+    }
+    feed(std::index_sequence_for<Policies...>());
+    opt_policy.finish();
+    for (auto& s : status) s.report();
+}
+
+// 要多遍重放的模式（-v、-l、-P）每遍都回到trace开头，管道和终端只能读一遍
+static bool seekable(const char* path) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_NONBLOCK);
+    if (fd == -1) return true;  // 打不开的留给TraceReader报错
+    bool ok = lseek(fd, 0, SEEK_CUR) != -1;
+    if (fd != STDIN_FILENO) close(fd);
+    return ok;
+}
+
+// 一遍扫描得到LRU的整条缺页率曲线
+template<typename Seq>
+static void miss_ratio_curve(const Options& opt, Seq& seq) {
+    StackDistance sd(opt.nframe, opt.rate);
+    for (access_t a : seq) sd.access(a.pid);
+    vector<double> faults = sd.faults();
+    printf("frames,faults,miss_ratio\n");
+    for (int n = 1; n <= opt.nframe; n++)
+        printf("%d,%.0f,%.6f\n", n, faults[n], sd.accesses() ? faults[n] / sd.accesses() : 0.0);
+}
+
+// 并行扫描，trace读入内存一次，所有任务共享
+static int run_sweep(Options& opt) {
+    if (opt.policies.empty()) opt.policies.assign(std::begin(POLICY_NAMES), std::end(POLICY_NAMES));
+    if (opt.frames.empty()) opt.frames.push_back(opt.nframe);
+    for (const auto& name : opt.policies) {
+        if (!visit_policy(name, []<typename>() {})) {
+            fprintf(stderr, "unknown policy: %s\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    for (int n : opt.frames) {
+        if (n <= 0) {
+            fprintf(stderr, "invalid frame count: %d\n", n);
+            return EXIT_FAILURE;
         }
-        // 插入新的
-        pages.insert({ cnt += 1, target });
     }
 
-    status.report();
+    vector<access_t> trace;
+    with_source(opt, [&](auto& seq) {
+        for (access_t a : seq) trace.push_back(a);
+    });
+    auto cells = sweep(trace, opt.policies, opt.frames, opt.nthread, opt.cost);
+    if (opt.json) print_json(cells);
+    else print_csv(cells);
+    return EXIT_SUCCESS;
 }
 
-// 二次机会法，FIFO的增强版本
-void PageReplacer::clock() {
-    struct page_t {
-        page pid = EMPTY_PAGE;
-        bool r = false;
+// 把合成负载写成二进制trace，格式与 -b 读入的相同
+static int dump_workload(const Options& opt) {
+    FILE* out = fopen(opt.out_path, "wb");
+    if (!out) {
+        perror(opt.out_path);
+        return EXIT_FAILURE;
+    }
+    vector<std::uint64_t> buf;
+    buf.reserve(1 << 16);
+    auto flush = [&] {
+        if (fwrite(buf.data(), sizeof(std::uint64_t), buf.size(), out) != buf.size()) {
+            perror(opt.out_path);
+            exit(EXIT_FAILURE);
+        }
+        buf.clear();
     };
-    vector<page_t> pages(nframe);
-    int i = 0;
-    for (page p : access_seq) {
-        status.access(p);
-        // 先判断是否命中
-        auto it = std::ranges::find_if(pages, [&p](page_t& page) {
-            return page.pid == p;
+    Workload seq(opt.workload, opt.count, opt.seed);
+    for (access_t a : seq) {
+        buf.push_back(static_cast<std::uint64_t>(a.pid) | (std::uint64_t)a.write << 63);
+        if (buf.size() == buf.capacity()) flush();
+    }
+    flush();
+    if (fclose(out) == EOF) {
+        perror(opt.out_path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// 各页大小下的TLB与页框置换，页框数按同样大小的物理内存折算
+static int run_tlb(Options& opt) {
+    std::string policy = opt.policies.empty() ? "lru" : opt.policies[0];
+    if (policy == "opt" || !visit_policy(policy, []<typename>() {})) {
+        fprintf(stderr, "unsupported policy for -P: %s\n", policy.c_str());
+        return EXIT_FAILURE;
+    }
+    if (opt.memory == 0) opt.memory = (std::uint64_t)opt.nframe << 12;
+
+    vector<TlbResult> results;
+    for (int shift : opt.page_shifts) {
+        int nframe = std::max<std::uint64_t>(opt.memory >> shift, 1);
+        visit_policy(policy, [&]<typename Policy>() {
+            if constexpr (!std::is_same_v<Policy, Opt>) {
+                if (!opt.workload.empty()) {
+                    // 合成负载的页号按4K页换算成地址
+                    Workload w(opt.workload, opt.count, opt.seed);
+                    auto addrs = std::views::transform(w, [](access_t a) {
+                        return access_t { a.pid << 12, a.write };
+                    });
+                    results.push_back(simulate_tlb<Policy>(addrs, shift, nframe, opt.tlb));
+                } else {
+                    TraceReader trace(opt.path, opt.format, opt.page_shift);
+                    results.push_back(simulate_tlb<Policy>(trace, shift, nframe, opt.tlb));
+                }
+            }
         });
-        // 命中，更改那个页的r标记
-        if (it != end(pages)) {
-            it->r = true;
-            continue;
+    }
+    print_tlb(results, opt.tlb);
+    return EXIT_SUCCESS;
+}
+
+// 在线顾问：访问按块推入，每window次访问查询一次，与嵌入服务时的用法相同
+static int run_advisor(Options& opt) {
+    if (opt.policies.empty())
+        for (const char* name : POLICY_NAMES)
+            if (std::string_view(name) != "opt") opt.policies.push_back(name);
+    if (opt.frames.empty()) opt.frames.push_back(opt.nframe);
+    // 每个窗口分成8个周期，当前周期为空时正好由前8个周期组成窗口
+    AdvisorConfig cfg { .epoch = std::max<std::uint64_t>(opt.advise / 8, 1), .history = 9,
+                        .rate = opt.rate, .cost = opt.cost };
+    Advisor advisor(cfg);
+    for (const auto& name : opt.policies) {
+        for (int n : opt.frames) {
+            if (!advisor.add(name, n)) {
+                fprintf(stderr, "unsupported policy or frame count for -A: %s, %d\n", name.c_str(), n);
+                return EXIT_FAILURE;
+            }
         }
-        // 未命中，开始考虑换掉的页
-        choose_victim:
-        auto& [old, r] = pages[i];
-        i = (i + 1) % pages.size();
-        if (r ^= true) goto choose_victim;
-        // 替换掉老页面
-        status.fault(old);
-        old = p;
-    }
-    status.report();
-}
-
-// 增强二次机会法
-void PageReplacer::enchanced_clock() {
-    struct page_t {
-        page pid = EMPTY_PAGE;
-        bool r = false;
-        bool d = false;
-    };
-    vector<page_t> pages(nframe);
-
-    int i = 0;
-    for (page p : access_seq) {
-        bool modified = random() % 2;
-        status.access(p);
-        if (modified) printf("this access will modify page %d\n", p);
-        // 先判断是否命中
-        auto it = std::ranges::find_if(pages, [&p](page_t& page) {
-            return page.pid == p;
+    }
+    with_source(opt, [&](auto& seq) {
+        vector<access_t> batch;
+        batch.reserve(4096);
+        auto push = [&] {
+            advisor.push(batch);
+            batch.clear();
+            if (advisor.accesses() % opt.advise == 0)
+                print_advisor(advisor.accesses(), advisor.query(opt.advise), advisor.accesses() == opt.advise);
+        };
+        for (access_t a : seq) {
+            batch.push_back(a);
+            // 块不跨越查询点
+            if (batch.size() == batch.capacity() || (advisor.accesses() + batch.size()) % opt.advise == 0) push();
+        }
+        if (!batch.empty()) push();
+    });
+    return EXIT_SUCCESS;
+}
+
+// 多租户：各租户的访问交错后共享一个页框池
+static int run_tenants(Options& opt) {
+    std::string policy = opt.policies.empty() ? "lru" : opt.policies[0];
+    std::string_view mode = opt.tenant_mode;
+    if (mode != "global" && mode != "local" && mode != "ws") {
+        fprintf(stderr, "unknown tenant mode: %s\n", opt.tenant_mode);
+        return EXIT_FAILURE;
+    }
+    if (policy == "opt" || !visit_policy(policy, []<typename>() {})) {
+        fprintf(stderr, "unsupported policy for tenants: %s\n", policy.c_str());
+        return EXIT_FAILURE;
+    }
+    int ntenant = opt.workload.empty() ? opt.paths.size() : opt.ntenant;
+    if (ntenant <= 0 || ntenant > MAX_TENANTS || (mode == "local" && opt.nframe < ntenant)) {
+        fprintf(stderr, "invalid tenant count: %d\n", ntenant);
+        return EXIT_FAILURE;
+    }
+    if (opt.window == 0) opt.window = 4 * (std::uint64_t)opt.nframe;
+
+    auto run = [&](auto& sources) {
+        TenantMix mix(sources, opt.quantum);
+        if (mode == "ws") {
+            print_tenants(run_working_set(mix, ntenant, opt.nframe, opt.window, opt.cost));
+            return;
+        }
+        visit_policy(policy, [&]<typename Policy>() {
+            if constexpr (!std::is_same_v<Policy, Opt>) {
+                if (mode == "global") print_tenants(run_global<Policy>(mix, ntenant, opt.nframe, opt.cost));
+                else print_tenants(run_local<Policy>(mix, ntenant, opt.nframe, opt.cost));
+            }
         });
-        // 命中，更改那个页的r/d标记
-        if (it != end(pages)) {
-            it->r = true;
-            it->d |= modified;
-            continue;
+    };
+    if (!opt.workload.empty()) {
+        // 租户很多时每个负载的缓冲区要小，zipf的表所有租户共用
+        Workload proto(opt.workload, opt.count, opt.seed);
+        vector<Workload> sources;
+        for (int t = 0; t < ntenant; t++) sources.push_back(proto.with_seed(opt.seed + t, 256));
+        run(sources);
+    } else {
+        // 每个trace占一个文件描述符，不够时先把软限制提到硬限制
+        rlimit lim;
+        if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < ntenant + 16u) {
+            lim.rlim_cur = std::min<rlim_t>(lim.rlim_max, ntenant + 16u);
+            setrlimit(RLIMIT_NOFILE, &lim);
+            if (lim.rlim_cur < ntenant + 16u) {
+                fprintf(stderr, "%d trace files exceed the open file limit %llu (see ulimit -n)\n", ntenant,
+                        (unsigned long long)lim.rlim_cur);
+                return EXIT_FAILURE;
+            }
         }
-        // 未命中，开始考虑换掉的页
-        int i_begin = i;
-
-    choose_victim_by_r_d: // 先扫描(r,d)均为0的
-        page_t& page = pages[i];
-        if (!page.r & !page.d) goto replace;
-        page.r = false;
-        if ((i = (i + 1) % pages.size()) != i_begin) goto choose_victim_by_r_d;
-        
-    choose_victim_by_r: // 退而求其次，扫描r为0。一定能找到
-        page = pages[i];
-        if (!page.r) goto replace;
-        if ((i = (i + 1) % pages.size()) != i_begin) goto choose_victim_by_r;
+        // 缓冲区随租户数缩小，总共大约与一个普通reader相当，但每个至少256次访问
+        size_t chunk = std::max<size_t>(TraceReader::CHUNK / ntenant, 256);
+        std::deque<TraceReader> sources;
+        for (const char* path : opt.paths) sources.emplace_back(path, opt.format, opt.page_shift, chunk);
+        run(sources);
+    }
+    return EXIT_SUCCESS;
+}
 
-    replace:
-        auto& [pid, r, d] = page;
-        status.fault(pid);
-        pid = p;
-        r = true;
-        d = modified;
+// 用trace文件或合成负载驱动所有算法，trace只按块读取，不会整体读入内存
+static int replay(int argc, char* argv[]) {
+    Options opt;
+    for (int c; (c = getopt(argc, argv, "bs:n:c:vl:mr:Sp:f:j:Jg:N:R:o:T:t:q:W:P:M:L:A:h")) != -1;) {
+        switch (c) {
+        case 'b': opt.format = TraceFormat::binary; break;
+        case 's': opt.page_shift = atoi(optarg); break;
+        case 'n': opt.nframe = atoi(optarg); break;
+        case 'c':
+            if (sscanf(optarg, "%lf,%lf", &opt.cost.read_us, &opt.cost.write_us) != 2) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'v': opt.verbose = true; break;
+        case 'l': opt.log_path = optarg; break;
+        case 'm': opt.mrc = true; break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 'S': opt.sweep = true; break;
+        case 'p': opt.policies = split(optarg); break;
+        case 'f':
+            for (const auto& n : split(optarg)) opt.frames.push_back(atoi(n.c_str()));
+            break;
+        case 'j': opt.nthread = atoi(optarg); break;
+        case 'J': opt.json = true; break;
+        case 'g':
+            if (!parse_workload(optarg, opt.workload)) return EXIT_FAILURE;
+            break;
+        case 'N': opt.count = strtod(optarg, nullptr); break;
+        case 'R': opt.seed = strtoull(optarg, nullptr, 0); break;
+        case 'o': opt.out_path = optarg; break;
+        case 'T': opt.tenant_mode = optarg; break;
+        case 't': opt.ntenant = atoi(optarg); break;
+        case 'q': opt.quantum = atoi(optarg); break;
+        case 'W': opt.window = strtod(optarg, nullptr); break;
+        case 'P':
+            for (const auto& size : split(optarg)) {
+                std::uint64_t bytes = parse_size(size.c_str());
+                if (bytes < 4096 || (bytes & (bytes - 1))) {
+                    fprintf(stderr, "invalid page size: %s\n", size.c_str());
+                    return EXIT_FAILURE;
+                }
+                opt.page_shifts.push_back(__builtin_ctzll(bytes));
+            }
+            break;
+        case 'M':
+            if (!(opt.memory = parse_size(optarg))) {
+                fprintf(stderr, "invalid memory size: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'L':
+            if (!parse_tlb(optarg, opt.tlb)) {
+                fprintf(stderr, "invalid TLB config (entries/ways must give a power-of-two set count): %s\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'A': opt.advise = strtod(optarg, nullptr); break;
+        default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    bool generated = !opt.workload.empty();
+    if (opt.tenant_mode && !generated && optind < argc) {
+        opt.paths.assign(argv + optind, argv + argc);
+        optind = argc - 1;  // 多个trace，下面按一个检查
+    }
+    if (optind != argc - (generated ? 0 : 1) || (opt.out_path && !generated)
+        || opt.nframe <= 0 || opt.page_shift < 0 || opt.page_shift > 63
+        || (opt.verbose && opt.log_path) || !(opt.rate > 0 && opt.rate <= 1)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!generated) opt.path = argv[optind];
 
-        i = (i + 1) % pages.size();
+    if (!generated && (opt.verbose || opt.log_path || !opt.page_shifts.empty()) && !seekable(opt.path)) {
+        fprintf(stderr, "%s: -v, -l and -P replay the trace several times and need a regular file\n", opt.path);
+        return EXIT_FAILURE;
     }
 
-    status.report();   
+    if (opt.out_path) return dump_workload(opt);
+    if (opt.tenant_mode) return run_tenants(opt);
+    if (!opt.page_shifts.empty()) return run_tlb(opt);
+    if (opt.advise) return run_advisor(opt);
+    if (opt.sweep) return run_sweep(opt);
+    with_source(opt, [&](auto& seq) {
+        if (opt.mrc) miss_ratio_curve(opt, seq);
+        else if (opt.verbose) replay_all<VerboseSink>(opt, seq);
+        else if (opt.log_path) replay_all<BinaryLogSink>(opt, seq);
+        else replay_lockstep<std::remove_reference_t<decltype(seq)>, Fifo, Lru, Lfu, LfuAging, Clock, EnhancedClock,
+                             Arc, TwoQ, Lirs, ClockPro>(opt, seq);
+    });
+    return EXIT_SUCCESS;
 }
 
-int main(int argc, char const *argv[]) {
-    std::mt19937 rng;
-    std::uniform_int_distribution dist(1, 10);
-    vector<int> seq(30);
+int main(int argc, char *argv[]) {
+    if (argc > 1) return replay(argc, argv);
+
+    std::mt19937 rng, write_rng(2);    // 读写标志另用一个引擎，页号序列与最初的演示相同
+    std::uniform_int_distribution<page> dist(1, 10);
+    std::bernoulli_distribution modify(0.5);
+    vector<access_t> seq(30);
 
     // 五次模拟
     for (int i : iota(0, 5)) {
         printf("\n\ntest %d\n", i + 1);
 
         // 生成序列
-        generate(seq, [&]() { return dist(rng); });
+        generate(seq, [&]() { return access_t { dist(rng), modify(write_rng) }; });
         
-        PageReplacer vmpr {
+        PageReplacer<vector<access_t>, VerboseSink> vmpr {
             .nframe = 6,
             .access_seq = seq
         };
@@ -250,4 +527,4 @@ int main(int argc, char const *argv[]) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
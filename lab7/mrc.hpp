@@ -0,0 +1,109 @@
+// LRU缺页率曲线（miss ratio curve），一遍扫描得到所有页框数下的缺页数
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
+
+// 页号的64位混合哈希（splitmix64），各位近似独立，用于采样和基数估计
+inline std::uint64_t page_hash(page p) {
+    std::uint64_t x = static_cast<std::uint64_t>(p) + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Mattson栈距离：一次访问的栈距离d是自上次访问该页以来访问过的不同页数+1，
+// LRU在页框数 >= d 时命中，因此栈距离的直方图就给出了所有页框数下的缺页数。
+// 用树状数组标记每个页最近一次访问的时刻，区间和即为两次访问之间的不同页数，每次O(log n)
+// 时刻编号用完时把仍然存活的标记重新压缩编号，内存只与不同页数有关，与trace长度无关
+//
+// rate < 1 时按SHARDS做空间采样：只跟踪哈希值落在前rate比例的页，
+// 距离和计数都按1/rate放大。缺页率的分母用实际的访问总数而不是采样数/rate，
+// 相当于把采样数与期望值的偏差补到距离最小的桶（SHARDS-adj）
+class StackDistance {
+    static constexpr std::uint64_t MODULUS = 1 << 24;
+
+    std::vector<std::int32_t> tree;                 // 树状数组，下标从1开始
+    std::unordered_map<page, std::int64_t> last;    // 页 -> 最近一次访问的时刻
+    std::int64_t now = 0;                           // 下一个可用的时刻编号
+
+    std::vector<double> hist;   // hist[d]：栈距离为d的访问数，d > max_frames的归入hist[0]
+    double cold = 0;            // 首次访问（冷缺页）
+    long long n_access = 0;
+    int max_frames;
+    double rate;
+    std::uint64_t threshold;
+
+    void add(std::int64_t i, int v) {
+        for (i++; i < (std::int64_t)tree.size(); i += i & -i) tree[i] += v;
+    }
+    // [0, i) 的前缀和
+    std::int64_t sum(std::int64_t i) const {
+        std::int64_t s = 0;
+        for (; i > 0; i -= i & -i) s += tree[i];
+        return s;
+    }
+
+    // 时刻用完，按原先的先后顺序把存活的标记压缩到 0..n-1，容量至少翻倍后重建
+    void compact() {
+        std::vector<std::pair<std::int64_t, page>> alive;
+        alive.reserve(last.size());
+        for (auto [p, t] : last) alive.push_back({ t, p });
+        std::sort(alive.begin(), alive.end());
+        size_t cap = std::max<size_t>(tree.size() - 1, 2 * alive.size() + 1024);
+        tree.assign(cap + 1, 0);
+        for (size_t i = 0; i < alive.size(); i++) {
+            last[alive[i].second] = i;
+            tree[i + 1] = 1;
+        }
+        // 线性时间建树
+        for (size_t i = 1; i <= cap; i++) {
+            size_t j = i + (i & -i);
+            if (j <= cap) tree[j] += tree[i];
+        }
+        now = alive.size();
+    }
+
+public:
+    explicit StackDistance(int max_frames, double rate = 1.0)
+        : tree(1024 + 1, 0), hist(max_frames + 1, 0), max_frames(max_frames), rate(rate),
+          threshold(static_cast<std::uint64_t>(rate * MODULUS)) {}
+
+    void access(page p) {
+        n_access += 1;
+        if (rate < 1.0 && page_hash(p) % MODULUS >= threshold) return;
+
+        if (now + 1 >= (std::int64_t)tree.size()) compact();
+        auto [it, fresh] = last.try_emplace(p, now);
+        if (fresh) {
+            cold += 1 / rate;
+        } else {
+            std::int64_t t = it->second;
+            // (t, now) 之间有标记的时刻数，即其间访问过的不同页数
+            std::int64_t d = sum(now) - sum(t + 1) + 1;
+            d = std::llround(d / rate);
+            hist[d <= max_frames ? d : 0] += 1 / rate;
+            add(t, -1);
+            it->second = now;
+        }
+        add(now++, 1);
+    }
+
+    long long accesses() const { return n_access; }
+
+    // 页框数为1..max_frames时的缺页数，faults[0]不使用
+    std::vector<double> faults() const {
+        std::vector<double> f(max_frames + 1, 0);
+        double miss = cold + hist[0];
+        for (int d = max_frames; d >= 1; d--) {
+            f[d] = miss;
+            miss += hist[d];
+        }
+        return f;
+    }
+};
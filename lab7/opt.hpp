@@ -0,0 +1,96 @@
+// Belady最优置换（OPT），换出下次访问最晚的页，作为其他算法的下界
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "trace.hpp"
+
+// OPT需要知道未来，所以access()除了页号还要给出该页下一次被访问的位置
+// 驻留页按下次访问位置放在有序集合里，换出集合中最大的，每次O(log n)
+struct Opt {
+    static constexpr std::int64_t NEVER = std::numeric_limits<std::int64_t>::max();
+
+    size_t nframe;
+    std::set<std::pair<std::int64_t, page>> by_next;    // (下次访问位置, 页)
+    std::unordered_map<page, std::int64_t> resident;    // 页 -> 下次访问位置
+
+    explicit Opt(int nframe) : nframe(nframe) {}
+
+    template<typename S>
+    void access(page p, std::int64_t next, S& status) {
+        auto it = resident.find(p);
+        if (it != resident.end()) {
+            by_next.erase({ it->second, p });
+            by_next.insert({ next, p });
+            it->second = next;
+            return;
+        }
+        if (resident.size() < nframe) {
+            status.fault();
+        } else {
+            auto victim = std::prev(by_next.end());
+            status.fault(victim->second);
+            resident.erase(victim->second);
+            by_next.erase(victim);
+        }
+        by_next.insert({ next, p });
+        resident[p] = next;
+    }
+};
+
+// 用OPT跑完整个序列。下次访问位置由一遍反向扫描得到。
+// trace太大放不进内存时按窗口处理：缓冲区保留2*window次访问，每次只处理前window次，
+// 所以每次访问至少能向后看window次，更远处的再次访问当作NEVER，此时结果是OPT的近似。
+// 整个序列不超过2*window时结果是精确的。
+// 访问由push()逐次推入，最后调用finish()，这样可以和其他算法在同一遍读取中同步推进
+template<typename S>
+class Belady {
+    Opt opt;
+    S& status;
+    size_t window;
+    std::vector<access_t> buf;
+    std::vector<std::int64_t> next;
+    std::unordered_map<page, size_t> later;  // 反向扫描时，页 -> 缓冲区中它下一次出现的下标
+    std::int64_t base = 0;                   // buf[0]在整个序列中的位置
+
+    // 处理缓冲区的前window次访问，last为真时处理全部
+    void step(bool last) {
+        next.resize(buf.size());
+        later.clear();
+        for (size_t i = buf.size(); i-- > 0;) {
+            auto [pos, fresh] = later.try_emplace(buf[i].pid, i);
+            next[i] = fresh ? Opt::NEVER : base + pos->second;
+            pos->second = i;
+        }
+
+        size_t n = last ? buf.size() : window;
+        for (size_t i = 0; i < n; i++) {
+            status.access(buf[i].pid, buf[i].write);
+            opt.access(buf[i].pid, next[i], status);
+        }
+        buf.erase(buf.begin(), buf.begin() + n);
+        base += n;
+    }
+
+public:
+    Belady(int nframe, S& status, size_t window = 1 << 22) : opt(nframe), status(status), window(window) {}
+
+    // 缓冲区满了之后又来一次访问，说明后面还有，才先处理前window次
+    void push(access_t a) {
+        if (buf.size() == 2 * window) step(false);
+        buf.push_back(a);
+    }
+    void finish() { step(true); }
+};
+
+template<typename Seq, typename S>
+void belady(Seq& seq, int nframe, S& status, size_t window = 1 << 22) {
+    Belady<S> b(nframe, status, window);
+    for (auto a : seq) b.push(to_access(a));
+    b.finish();
+}
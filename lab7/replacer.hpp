@@ -0,0 +1,411 @@
+// 页面置换算法
+#pragma once
+
+#include <vector>
+#include <ranges>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <type_traits>
+
+#include "trace.hpp"
+#include "sink.hpp"
+#include "frame_index.hpp"
+#include "frame_table.hpp"
+#include "scan_resistant.hpp"
+#include "opt.hpp"
+
+using std::vector,
+    std::list,
+    std::unordered_map;
+
+// 缺页读入和脏页写回的I/O代价（微秒），用来估算缺页造成的停顿时间
+struct IoCost {
+    double read_us = 100;
+    double write_us = 250;
+};
+
+// 访问/缺页/写回计数，事件的输出交给Sink（见sink.hpp），默认只计数
+// 脏页由Status统一记录：写访问把页标脏，脏页被换出时计一次写回，
+// 所以任何算法都能得到写回次数，算法本身不必关心
+template<typename Sink = CountingSink>
+class Status {
+    page cur;
+    bool cur_write = false;
+    long long n_access = 0, n_fault = 0, n_writeback = 0;
+    FrameIndex dirty { 0 };  // 驻留的脏页
+public:
+    [[no_unique_address]] Sink sink;
+    IoCost cost;
+
+    // 开始一轮模拟
+    void start(int nframe) {
+        dirty = FrameIndex(nframe);
+    }
+    void access(page to, bool write = false) {
+        n_access += 1;
+        cur = to;
+        cur_write = write;
+        sink.access(to);
+        if (write) {
+            sink.modify(to);
+            dirty.insert(to, 1);
+        }
+    }
+    // 当前访问是否为写，供需要脏位的算法（增强二次机会法）使用
+    bool writing() const { return cur_write; }
+    void fault(page victim = EMPTY_PAGE) {
+        n_fault += 1;
+        sink.fault(victim, cur);
+        if (victim != EMPTY_PAGE && dirty.find(victim) != -1) {
+            dirty.erase(victim);
+            n_writeback += 1;
+        }
+    }
+    long long accesses() const { return n_access; }
+    long long faults() const { return n_fault; }
+    long long writebacks() const { return n_writeback; }
+    // 估算的I/O停顿时间（毫秒）：每次缺页读入一页，每个脏页换出时写回一页
+    double stall_ms() const {
+        return (n_fault * cost.read_us + n_writeback * cost.write_us) / 1000;
+    }
+    void report() {
+        printf("=== page fault report ==\n");
+        sink.report();
+        printf("Number of page faults: %lld\n", n_fault);
+        if (n_access > 0)
+            printf("Rate of page faults: %.1f%%\n", 100.0 * n_fault / n_access);
+        printf("Number of write-backs: %lld\n", n_writeback);
+        printf("Estimated I/O stall: %.3f ms\n", stall_ms());
+        printf("=== report end ==\n\n");
+
+        // 清理
+        n_access = 0;
+        n_fault = 0;
+        n_writeback = 0;
+    }
+};
+
+// 每个算法是一个独立的状态机，access()处理一次访问，缺页时调用status.fault()
+// 这样算法本身不关心访问序列从哪来，内存里的vector和流式读取的trace都能喂给它
+
+// FIFO算法
+// 页框数组之外维护一个页号到页框的索引，命中判断和换出都是O(1)
+struct Fifo {
+    vector<page> pages;
+    FrameIndex index;
+    size_t i = 0;
+
+    explicit Fifo(int nframe) : pages(nframe, EMPTY_PAGE), index(nframe) {}
+
+    template<typename S>
+    void access(page target, S& status) {
+        if (index.find(target) != -1) return;
+        status.fault(pages[i]);
+        if (pages[i] != EMPTY_PAGE) index.erase(pages[i]);
+        pages[i] = target;
+        index.insert(target, i);
+        i = (i + 1) % pages.size();
+    }
+};
+
+// LRU算法
+// 使用双向链表实现，哈希表优化查找时间
+struct Lru {
+    size_t nframe;
+    list<page> pages;
+    unordered_map<page, list<page>::iterator> iters;
+
+    explicit Lru(int nframe) : nframe(nframe) {}
+
+    template<typename S>
+    void access(page target, S& status) {
+        // 命中，将命中页前置
+        if (auto it = iters.find(target); it != iters.end()) {
+            pages.splice(pages.begin(), pages, it->second);
+            return;
+        }
+
+        // 未命中，加入target
+        pages.push_front(target);
+        iters[target] = pages.begin();
+
+        if (pages.size() > nframe) {
+            // 如果超出frame限制，则去掉最后的
+            page victim = pages.back();
+            iters.erase(victim);
+            pages.pop_back();
+            status.fault(victim);
+        } else {
+            status.fault();
+        }
+    }
+};
+
+// LFU算法，替换使用频率最低的页，频率相同时换出最早进入该频率的页
+// 按频率分桶：桶按频率升序串成双向链表，表头就是最小频率，
+// 每个桶内是该频率的页组成的链表。命中时页移到频率+1的桶，缺页时换出表头桶的第一个页，
+// 都是O(1)。页和桶的结点都在构造时按页框数一次分配好，用下标相连，运行中不再分配内存
+// aging_period > 0 时每隔这么多次访问把所有频率减半，让过去的热点逐渐冷却（LFU-aging）
+struct Lfu {
+    struct item_t {
+        page pid = EMPTY_PAGE;
+        int bucket = -1;
+        int prev = -1, next = -1;
+    };
+    struct bucket_t {
+        long long freq = 0;
+        int head = -1, tail = -1;
+        int prev = -1, next = -1;
+    };
+    vector<item_t> items;      // 每个页框一个结点
+    vector<bucket_t> buckets;  // 桶的结点池，非空的桶最多nframe个，touch时临时多一个
+    int free_bucket = 0;       // 空闲桶链表，用next相连
+    int min_bucket = -1;       // 频率最小的桶，即桶链表的表头
+    int used = 0;
+    FrameIndex index;
+    long long aging_period, ticks = 0;
+
+    explicit Lfu(int nframe, long long aging_period = 0)
+        : items(nframe), buckets(nframe + 1), index(nframe), aging_period(aging_period) {
+        for (int b = 0; b < nframe; b++) buckets[b].next = b + 1;
+        buckets[nframe].next = -1;
+    }
+
+    // 新建频率为freq的桶，插在after之后，after为-1时插在表头
+    int new_bucket(long long freq, int after) {
+        int b = free_bucket;
+        free_bucket = buckets[b].next;
+        int next = after == -1 ? min_bucket : buckets[after].next;
+        buckets[b] = { freq, -1, -1, after, next };
+        if (after == -1) min_bucket = b;
+        else buckets[after].next = b;
+        if (next != -1) buckets[next].prev = b;
+        return b;
+    }
+
+    void release_bucket(int b) {
+        auto [freq, head, tail, prev, next] = buckets[b];
+        if (prev == -1) min_bucket = next;
+        else buckets[prev].next = next;
+        if (next != -1) buckets[next].prev = prev;
+        buckets[b].next = free_bucket;
+        free_bucket = b;
+    }
+
+    void push_back(int b, int x) {
+        bucket_t& bk = buckets[b];
+        items[x].bucket = b;
+        items[x].prev = bk.tail;
+        items[x].next = -1;
+        if (bk.tail == -1) bk.head = x;
+        else items[bk.tail].next = x;
+        bk.tail = x;
+    }
+
+    // 把页从所在的桶中摘下，桶空了就回收
+    void unlink(int x) {
+        auto [pid, b, prev, next] = items[x];
+        if (prev == -1) buckets[b].head = next;
+        else items[prev].next = next;
+        if (next != -1) items[next].prev = prev;
+        else buckets[b].tail = prev;
+        if (buckets[b].head == -1) release_bucket(b);
+    }
+
+    // 命中，频率+1
+    void touch(int x) {
+        int b = items[x].bucket;
+        long long freq = buckets[b].freq + 1;
+        int nb = buckets[b].next;
+        if (nb == -1 || buckets[nb].freq != freq) nb = new_bucket(freq, b);
+        unlink(x);
+        push_back(nb, x);
+    }
+
+    // 所有频率减半（向上取整，不会减到0），减半后频率相同的相邻桶合并，
+    // 原来频率低的页排在前面，仍然先被换出
+    void age() {
+        for (int b = min_bucket; b != -1;) {
+            int next = buckets[b].next;
+            buckets[b].freq -= buckets[b].freq / 2;
+            int prev = buckets[b].prev;
+            if (prev != -1 && buckets[prev].freq == buckets[b].freq) {
+                for (int x = buckets[b].head; x != -1; x = items[x].next) items[x].bucket = prev;
+                items[buckets[prev].tail].next = buckets[b].head;
+                items[buckets[b].head].prev = buckets[prev].tail;
+                buckets[prev].tail = buckets[b].tail;
+                buckets[b].head = -1;
+                release_bucket(b);
+            }
+            b = next;
+        }
+    }
+
+    template<typename S>
+    void access(page target, S& status) {
+        if (aging_period > 0 && ++ticks == aging_period) {
+            ticks = 0;
+            age();
+        }
+        if (int x = index.find(target); x != -1) {
+            touch(x);
+            return;
+        }
+
+        int x;
+        if (used < (int)items.size()) {
+            // 尚有空页
+            x = used++;
+            status.fault();
+        } else {
+            // 未命中，替换掉频率最低的
+            x = buckets[min_bucket].head;
+            status.fault(items[x].pid);
+            index.erase(items[x].pid);
+            unlink(x);
+        }
+        items[x].pid = target;
+        index.insert(target, x);
+        int b = min_bucket;
+        if (b == -1 || buckets[b].freq != 1) b = new_bucket(1, -1);
+        push_back(b, x);
+    }
+};
+
+// 带老化的LFU，每nframe次访问频率减半
+struct LfuAging : Lfu {
+    explicit LfuAging(int nframe) : Lfu(nframe, nframe) {}
+};
+
+// 二次机会法，FIFO的增强版本
+struct Clock {
+    FrameTable frames;
+    FrameIndex index;
+    size_t i = 0;
+
+    explicit Clock(int nframe) : frames(nframe), index(nframe) {}
+
+    template<typename S>
+    void access(page p, S& status) {
+        // 命中，更改那个页的r标记
+        if (int f = index.find(p); f != -1) {
+            frames.set_r(f, true);
+            return;
+        }
+        // 未命中，指针扫过的r=1的页给第二次机会，遇到第一个r=0的页换出
+        // 全部r=1时扫完一圈r都被清掉，换出指针处的页
+        size_t f = frames.find_clear_r(i);
+        if (f == FrameTable::npos) f = i;
+        page& old = frames.pid(f);
+        status.fault(old);
+        if (old != EMPTY_PAGE) index.erase(old);
+        old = p;
+        frames.set_r(f, true);
+        index.insert(p, f);
+        i = (f + 1) % frames.size();
+    }
+};
+
+// 增强二次机会法
+struct EnhancedClock {
+    FrameTable frames;
+    FrameIndex index;
+    size_t i = 0;
+
+    explicit EnhancedClock(int nframe) : frames(nframe), index(nframe) {}
+
+    template<typename S>
+    void access(page p, S& status) {
+        bool modified = status.writing();
+        // 命中，更改那个页的r/d标记
+        if (int f = index.find(p); f != -1) {
+            frames.set_r(f, true);
+            if (modified) frames.set_d(f, true);
+            return;
+        }
+        // 未命中，先扫描(r,d)均为0的，扫过的页清掉r
+        // 找不到时所有r都已清掉，退而求其次扫描r为0的，指针处的页就是第一个
+        size_t f = frames.find_clear_rd(i);
+        if (f == FrameTable::npos) f = i;
+        page& pid = frames.pid(f);
+        status.fault(pid);
+        if (pid != EMPTY_PAGE) index.erase(pid);
+        pid = p;
+        frames.set_r(f, true);
+        frames.set_d(f, modified);
+        index.insert(p, f);
+        i = (f + 1) % frames.size();
+    }
+};
+
+// Seq可以是内存中的vector<page>/vector<access_t>，也可以是流式的TraceReader
+// Sink决定逐次访问的事件如何输出，默认只计数
+template<typename Seq = vector<page>, typename Sink = CountingSink>
+struct PageReplacer {
+    Status<Sink> status;
+    int nframe;
+    Seq access_seq;
+
+    // 只模拟不报告，结果留在status中
+    template<typename Policy>
+    void simulate() {
+        status.start(nframe);
+        if constexpr (std::is_same_v<Sink, VerboseSink>) status.sink.show_writes = std::is_same_v<Policy, EnhancedClock>;
+        if constexpr (std::is_same_v<Policy, Opt>) {
+            // OPT要预知未来，由belady()按窗口预先算出每次访问的下次访问位置
+            belady(access_seq, nframe, status);
+        } else {
+            Policy policy(nframe);
+            for (auto a : access_seq) {
+                auto [target, write] = to_access(a);
+                status.access(target, write);
+                policy.access(target, status);
+            }
+        }
+    }
+
+    template<typename Policy>
+    void run() {
+        simulate<Policy>();
+        status.report();
+    }
+
+    void fifo() { run<Fifo>(); }
+    void lru() { run<Lru>(); }
+    void lfu() { run<Lfu>(); }
+    void lfu_aging() { run<LfuAging>(); }
+    void clock() { run<Clock>(); }
+    void enchanced_clock() { run<EnhancedClock>(); }
+    void arc() { run<Arc>(); }
+    void two_q() { run<TwoQ>(); }
+    void lirs() { run<Lirs>(); }
+    void clock_pro() { run<ClockPro>(); }
+    void opt() { run<Opt>(); }
+};
+
+// 按名字选择算法，f是模板lambda，以 f.template operator()<Policy>() 的形式拿到算法类型
+inline constexpr const char* POLICY_NAMES[] = {
+    "fifo", "lru", "lfu", "lfu_aging", "clock", "enhanced_clock",
+    "arc", "2q", "lirs", "clock_pro", "opt",
+};
+
+template<typename F>
+bool visit_policy(std::string_view name, F&& f) {
+    if (name == "fifo") f.template operator()<Fifo>();
+    else if (name == "lru") f.template operator()<Lru>();
+    else if (name == "lfu") f.template operator()<Lfu>();
+    else if (name == "lfu_aging") f.template operator()<LfuAging>();
+    else if (name == "clock") f.template operator()<Clock>();
+    else if (name == "enhanced_clock") f.template operator()<EnhancedClock>();
+    else if (name == "arc") f.template operator()<Arc>();
+    else if (name == "2q") f.template operator()<TwoQ>();
+    else if (name == "lirs") f.template operator()<Lirs>();
+    else if (name == "clock_pro") f.template operator()<ClockPro>();
+    else if (name == "opt") f.template operator()<Opt>();
+    else return false;
+    return true;
+}
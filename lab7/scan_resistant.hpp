@@ -0,0 +1,430 @@
+// 抗扫描的置换算法：ARC、2Q、LIRS、CLOCK-Pro
+// 与replacer.hpp中的算法接口相同：构造时给出页框数，access()处理一次访问，缺页时调用status.fault()
+#pragma once
+
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
+#include "frame_index.hpp"
+
+// 带索引的页链表，表头为最近加入的页，查找、摘除、移到表头都是O(1)
+class PageList {
+    std::list<page> pages;
+    std::unordered_map<page, std::list<page>::iterator> iters;
+public:
+    size_t size() const { return pages.size(); }
+    bool empty() const { return pages.empty(); }
+    bool contains(page p) const { return iters.contains(p); }
+    page back() const { return pages.back(); }
+
+    void push_front(page p) {
+        pages.push_front(p);
+        iters[p] = pages.begin();
+    }
+    void to_front(page p) {
+        pages.splice(pages.begin(), pages, iters[p]);
+    }
+    void erase(page p) {
+        auto it = iters.find(p);
+        pages.erase(it->second);
+        iters.erase(it);
+    }
+    page pop_back() {
+        page p = pages.back();
+        iters.erase(p);
+        pages.pop_back();
+        return p;
+    }
+};
+
+// ARC（Megiddo & Modha）：T1放只访问过一次的页，T2放访问过至少两次的页，
+// B1、B2分别记录最近从T1、T2换出的页号（不占页框）。
+// 在B1中命中说明T1太小，在B2中命中说明T2太小，据此调整T1的目标大小p
+struct Arc {
+    size_t c;
+    double p = 0;
+    PageList t1, t2, b1, b2;
+
+    explicit Arc(int nframe) : c(nframe) {}
+
+    // 按p从T1或T2换出一页到对应的B
+    page replace(bool in_b2) {
+        page victim;
+        if (!t1.empty() && (t1.size() > p || (in_b2 && t1.size() == p))) {
+            victim = t1.pop_back();
+            b1.push_front(victim);
+        } else {
+            victim = t2.pop_back();
+            b2.push_front(victim);
+        }
+        return victim;
+    }
+
+    template<typename S>
+    void access(page x, S& status) {
+        if (t1.contains(x)) {
+            t1.erase(x);
+            t2.push_front(x);
+            return;
+        }
+        if (t2.contains(x)) {
+            t2.to_front(x);
+            return;
+        }
+
+        if (b1.contains(x)) {
+            p = std::min<double>(c, p + std::max<double>((double)b2.size() / b1.size(), 1));
+            status.fault(replace(false));
+            b1.erase(x);
+            t2.push_front(x);
+            return;
+        }
+        if (b2.contains(x)) {
+            p = std::max<double>(0, p - std::max<double>((double)b1.size() / b2.size(), 1));
+            status.fault(replace(true));
+            b2.erase(x);
+            t2.push_front(x);
+            return;
+        }
+
+        // 完全没见过的页
+        page victim = EMPTY_PAGE;
+        if (t1.size() + b1.size() == c) {
+            if (t1.size() < c) {
+                b1.pop_back();
+                victim = replace(false);
+            } else {
+                victim = t1.pop_back();
+            }
+        } else {
+            size_t total = t1.size() + t2.size() + b1.size() + b2.size();
+            if (total >= c) {
+                if (total == 2 * c) b2.pop_back();
+                if (t1.size() + t2.size() == c) victim = replace(false);
+            }
+        }
+        status.fault(victim);
+        t1.push_front(x);
+    }
+};
+
+// 2Q（Johnson & Shasha）：第一次访问的页进入FIFO队列A1in，从A1in换出后页号记入A1out，
+// 在A1out期间再次访问才进入LRU队列Am。只被扫描一次的页不会挤掉Am中的热页
+struct TwoQ {
+    size_t c, k_in, k_out;
+    PageList a1in, a1out, am;
+
+    explicit TwoQ(int nframe)
+        : c(nframe), k_in(std::max(1, nframe / 4)), k_out(std::max(1, nframe / 2)) {}
+
+    // 为新页腾出页框，返回换出的页
+    page reclaim() {
+        if (am.size() + a1in.size() < c) return EMPTY_PAGE;
+        if (a1in.size() > k_in || am.empty()) {
+            page y = a1in.pop_back();
+            a1out.push_front(y);
+            if (a1out.size() > k_out) a1out.pop_back();
+            return y;
+        }
+        return am.pop_back();
+    }
+
+    template<typename S>
+    void access(page x, S& status) {
+        if (am.contains(x)) {
+            am.to_front(x);
+            return;
+        }
+        if (a1in.contains(x)) return;
+
+        // 先查A1out再腾页框：reclaim()往A1out里放页时可能把队尾的x挤掉
+        bool ghost = a1out.contains(x);
+        if (ghost) a1out.erase(x);
+        status.fault(reclaim());
+        if (ghost) am.push_front(x);
+        else a1in.push_front(x);
+    }
+};
+
+// LIRS（Jiang & Zhang）：用重用距离区分LIR（热）页和HIR（冷）页。
+// 栈S按最近访问排序，记录LIR页和最近访问过的HIR页（包括已换出的）；
+// 队列Q放驻留的HIR页，缺页时从Q换出。S底部总是LIR页，底部的非LIR页会被修剪掉。
+// S中已换出的HIR页最多保留nframe个，超过时丢掉最老的，保证内存有界
+struct Lirs {
+    enum state_t { LIR, HIR, NONRESIDENT };
+
+    size_t l_hirs, l_lirs;  // HIR、LIR页各占的页框数
+    size_t n_lir = 0;
+    PageList s, q, ghosts;  // ghosts：S中已换出的HIR页，按换出顺序
+    std::unordered_map<page, state_t> state;
+
+    explicit Lirs(int nframe)
+        : l_hirs(nframe > 1 ? std::max(1, nframe / 100) : 1), l_lirs(nframe - l_hirs) {}
+
+    // 修剪S的底部，直到底部是LIR页
+    void prune() {
+        while (!s.empty() && state[s.back()] != LIR) {
+            page y = s.pop_back();
+            if (state[y] == NONRESIDENT) {
+                ghosts.erase(y);
+                state.erase(y);
+            }
+        }
+    }
+
+    // S底部的LIR页降级为驻留的HIR页，移到Q的尾部
+    void demote_bottom() {
+        page y = s.pop_back();
+        state[y] = HIR;
+        q.push_front(y);
+        n_lir -= 1;
+        prune();
+    }
+
+    void promote(page x) {
+        state[x] = LIR;
+        n_lir += 1;
+        demote_bottom();
+    }
+
+    template<typename S>
+    void access(page x, S& status) {
+        auto it = state.find(x);
+        if (it != state.end() && it->second == LIR) {
+            bool bottom = s.back() == x;
+            s.to_front(x);
+            if (bottom) prune();
+            return;
+        }
+        if (it != state.end() && it->second == HIR) {
+            if (s.contains(x)) {
+                s.to_front(x);
+                q.erase(x);
+                if (l_lirs > 0) promote(x);
+                else q.push_front(x);
+            } else {
+                s.push_front(x);
+                q.to_front(x);
+            }
+            return;
+        }
+
+        // 缺页
+        bool in_s = it != state.end();  // 已换出但仍在S中的HIR页
+        if (n_lir < l_lirs) {
+            // 预热阶段，LIR还没满，直接成为LIR
+            if (in_s) {
+                ghosts.erase(x);
+                s.to_front(x);
+            } else {
+                s.push_front(x);
+            }
+            state[x] = LIR;
+            n_lir += 1;
+            status.fault();
+            return;
+        }
+
+        page victim = EMPTY_PAGE;
+        if (q.size() >= l_hirs) {
+            victim = q.pop_back();
+            if (s.contains(victim)) {
+                state[victim] = NONRESIDENT;
+                ghosts.push_front(victim);
+                if (ghosts.size() > l_lirs + l_hirs) {
+                    page old = ghosts.pop_back();
+                    s.erase(old);
+                    state.erase(old);
+                }
+            } else {
+                state.erase(victim);
+            }
+        }
+        status.fault(victim);
+
+        if (in_s && s.contains(x)) {
+            ghosts.erase(x);
+            s.to_front(x);
+            if (l_lirs > 0) {
+                promote(x);
+                return;
+            }
+        } else {
+            s.push_front(x);
+        }
+        state[x] = HIR;
+        q.push_front(x);
+    }
+};
+
+// CLOCK-Pro（Jiang, Chen & Zhang）：LIRS思想的时钟近似。所有页放在一个环上，
+// 分为热页、冷页，冷页在"测试期"内被换出时只保留页号（非驻留页）。
+//   hand_cold：缺页时换出冷页；测试期内被访问过的冷页升为热页
+//   hand_hot ：热页超过份额时把未被访问的热页降为冷页
+//   hand_test：非驻留页超过nframe个时丢掉最老的，同时结束所经冷页的测试期
+// 非驻留页在测试期内再次被访问说明冷页份额太小，cold_target加一；
+// 非驻留页测试期结束仍未被访问则减一
+struct ClockPro {
+    struct node_t {
+        page pid = EMPTY_PAGE;
+        int prev = -1, next = -1;
+        bool hot = false;
+        bool resident = false;
+        bool test = false;  // 冷页是否在测试期
+        bool ref = false;
+    };
+
+    int mem;                    // 页框数
+    int cold_target;            // 驻留冷页的目标数量
+    int n_hot = 0, n_cold = 0, n_nonresident = 0;
+    int hand_hot = -1, hand_cold = -1, hand_test = -1;
+    std::vector<node_t> nodes;  // 驻留页最多mem个，非驻留页最多mem个，另留一个给正在加入的页
+    std::vector<int> free_nodes;
+    FrameIndex index;           // 页号 -> 结点
+
+    explicit ClockPro(int nframe)
+        : mem(nframe), cold_target(std::max(1, nframe / 100)),
+          nodes(2 * nframe + 1), index(2 * nframe + 1) {
+        for (int i = 2 * nframe; i >= 0; i--) free_nodes.push_back(i);
+    }
+
+    int next(int r) const { return nodes[r].next; }
+
+    // 插到hand_hot之前，即环上最新的位置
+    void link(int r) {
+        if (hand_hot == -1) {
+            nodes[r].prev = nodes[r].next = r;
+            hand_hot = hand_cold = hand_test = r;
+            return;
+        }
+        int nx = hand_hot, pv = nodes[nx].prev;
+        nodes[r].prev = pv;
+        nodes[r].next = nx;
+        nodes[pv].next = r;
+        nodes[nx].prev = r;
+    }
+
+    // 从环上摘下结点，指向它的指针前进一格
+    void remove(int r) {
+        int nx = nodes[r].next;
+        if (nx == r) {
+            hand_hot = hand_cold = hand_test = -1;
+        } else {
+            if (hand_hot == r) hand_hot = nx;
+            if (hand_cold == r) hand_cold = nx;
+            if (hand_test == r) hand_test = nx;
+            nodes[nodes[r].prev].next = nx;
+            nodes[nx].prev = nodes[r].prev;
+        }
+        index.erase(nodes[r].pid);
+        free_nodes.push_back(r);
+    }
+
+    // 降一个热页为冷页
+    void run_hand_hot() {
+        while (true) {
+            node_t& e = nodes[hand_hot];
+            int r = hand_hot;
+            hand_hot = next(r);
+            if (!e.hot) continue;
+            if (e.ref) {
+                e.ref = false;
+                continue;
+            }
+            e.hot = false;
+            e.test = false;
+            n_hot -= 1;
+            n_cold += 1;
+            return;
+        }
+    }
+
+    // 丢掉一个非驻留页，所经过的冷页结束测试期
+    void run_hand_test() {
+        while (true) {
+            int r = hand_test;
+            node_t& e = nodes[r];
+            hand_test = next(r);
+            if (e.hot) continue;
+            e.test = false;
+            if (!e.resident) {
+                remove(r);
+                n_nonresident -= 1;
+                if (cold_target > 1) cold_target -= 1;
+                return;
+            }
+        }
+    }
+
+    // 换出一个冷页，返回被换出的页
+    page run_hand_cold() {
+        while (true) {
+            int r = hand_cold;
+            node_t& e = nodes[r];
+            hand_cold = next(r);
+            if (e.hot || !e.resident) continue;
+            if (e.ref) {
+                e.ref = false;
+                if (e.test) {
+                    // 测试期内再次访问，升为热页
+                    e.hot = true;
+                    e.test = false;
+                    n_cold -= 1;
+                    n_hot += 1;
+                    while (n_hot > mem - cold_target) run_hand_hot();
+                } else {
+                    e.test = true;
+                }
+                continue;
+            }
+            page victim = e.pid;
+            n_cold -= 1;
+            if (e.test) {
+                // 测试期内换出，留下页号
+                e.resident = false;
+                n_nonresident += 1;
+                while (n_nonresident > mem) run_hand_test();
+            } else {
+                remove(r);
+            }
+            return victim;
+        }
+    }
+
+    template<typename S>
+    void access(page x, S& status) {
+        int r = index.find(x);
+        if (r != -1 && nodes[r].resident) {
+            nodes[r].ref = true;
+            return;
+        }
+
+        page victim = n_hot + n_cold == mem ? run_hand_cold() : EMPTY_PAGE;
+        status.fault(victim);
+
+        // 换出时可能已经把x的非驻留结点丢掉了，重新查一次
+        r = index.find(x);
+        if (r != -1) {
+            // 非驻留页在测试期内被访问：冷页份额太小，加大并让它直接成为热页
+            if (cold_target < mem) cold_target += 1;
+            node_t& e = nodes[r];
+            e.resident = true;
+            e.hot = true;
+            e.test = false;
+            e.ref = false;
+            n_nonresident -= 1;
+            n_hot += 1;
+            while (n_hot > mem - cold_target) run_hand_hot();
+        } else {
+            r = free_nodes.back();
+            free_nodes.pop_back();
+            nodes[r] = { x, -1, -1, false, true, true, false };
+            link(r);
+            index.insert(x, r);
+            n_cold += 1;
+        }
+    }
+};
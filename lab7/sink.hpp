@@ -0,0 +1,109 @@
+// Status的事件输出策略，作为模板参数在编译期选定
+// 每个sink提供 access / fault / modify / report 四个钩子
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+// 只计数，不输出任何东西。所有钩子都是空函数，内联后Status只剩几次自增
+struct CountingSink {
+    void access(page) {}
+    void fault(page, page) {}
+    void modify(page) {}
+    void report() {}
+};
+
+// 逐次访问的文本输出，即实验最初的打印方式，只适合短序列
+struct VerboseSink {
+    std::vector<page> eliminateds;
+    bool show_writes = false;   // 只有增强二次机会法看读写，和最初一样只在它的重放里打印写访问
+
+    void access(page to) {
+        printf("accessing %lld\n", (long long)to);
+    }
+    void fault(page victim, page cur) {
+        printf("%lld -> %lld\n", (long long)victim, (long long)cur);
+        if (victim != EMPTY_PAGE) eliminateds.push_back(victim);
+    }
+    void modify(page p) {
+        if (show_writes) printf("this access will modify page %lld\n", (long long)p);
+    }
+    void report() {
+        printf("Eliminate pages:");
+        for (page p : eliminateds) printf(" %lld", (long long)p);
+        printf("\n");
+        eliminateds.clear();
+    }
+};
+
+// 带缓冲的二进制事件日志，每次访问一条记录 {page, victim}：
+//   victim == HIT        命中
+//   victim == EMPTY_PAGE 缺页，放入空页框
+//   其他                 缺页，换出victim
+// 每次report()写入一条 {EMPTY_PAGE, EMPTY_PAGE} 作为一轮算法的结束标记
+class BinaryLogSink {
+public:
+    static constexpr page HIT = -2;
+    struct event {
+        page target;
+        page victim;
+    };
+
+private:
+    static constexpr size_t BUF_SIZE = 1 << 14;
+    int fd = -1;
+    event buf[BUF_SIZE];
+    size_t n = 0;
+
+    void flush() {
+        const char* p = reinterpret_cast<const char*>(buf);
+        size_t left = n * sizeof(event);
+        while (left > 0) {
+            ssize_t w = write(fd, p, left);
+            if (w == -1) {
+                perror("write event log");
+                exit(EXIT_FAILURE);
+            }
+            p += w;
+            left -= w;
+        }
+        n = 0;
+    }
+
+public:
+    BinaryLogSink() = default;
+    BinaryLogSink(const BinaryLogSink&) = delete;
+    BinaryLogSink& operator=(const BinaryLogSink&) = delete;
+    ~BinaryLogSink() {
+        if (fd == -1) return;
+        flush();
+        close(fd);
+    }
+
+    void open(const char* path) {
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void access(page to) {
+        if (n == BUF_SIZE) flush();
+        buf[n++] = { to, HIT };
+    }
+    void fault(page victim, page) {
+        buf[n - 1].victim = victim;
+    }
+    void modify(page) {}
+    void report() {
+        if (n == BUF_SIZE) flush();
+        buf[n++] = { EMPTY_PAGE, EMPTY_PAGE };
+        flush();
+    }
+};
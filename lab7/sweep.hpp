@@ -0,0 +1,73 @@
+// 算法 × 页框数 的参数扫描，每个格子作为一个任务并行执行
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "replacer.hpp"
+#include "thread_pool.hpp"
+
+struct SweepCell {
+    std::string policy;
+    int nframe;
+    long long accesses = 0, faults = 0, writebacks = 0;
+    double stall_ms = 0;
+    double seconds = 0;
+};
+
+// 所有格子共享同一份只读的trace，每个格子有自己的PageReplacer，互不干扰
+inline std::vector<SweepCell> sweep(std::span<const access_t> trace,
+                                    const std::vector<std::string>& policies,
+                                    const std::vector<int>& frames, unsigned nthread = 0,
+                                    IoCost cost = {}) {
+    std::vector<SweepCell> cells;
+    for (const auto& policy : policies)
+        for (int n : frames) cells.push_back({ policy, n });
+
+    std::vector<std::function<void()>> tasks;
+    for (SweepCell& cell : cells) {
+        tasks.push_back([&cell, trace, cost] {
+            auto begin = std::chrono::steady_clock::now();
+            visit_policy(cell.policy, [&]<typename Policy>() {
+                PageReplacer<std::span<const access_t>> vmpr {
+                    .nframe = cell.nframe,
+                    .access_seq = trace
+                };
+                vmpr.status.cost = cost;
+                vmpr.template simulate<Policy>();
+                cell.accesses = vmpr.status.accesses();
+                cell.faults = vmpr.status.faults();
+                cell.writebacks = vmpr.status.writebacks();
+                cell.stall_ms = vmpr.status.stall_ms();
+            });
+            cell.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        });
+    }
+    parallel_run(std::move(tasks), nthread);
+    return cells;
+}
+
+inline void print_csv(const std::vector<SweepCell>& cells, FILE* out = stdout) {
+    fprintf(out, "policy,frames,accesses,faults,miss_ratio,writebacks,stall_ms,seconds\n");
+    for (const auto& c : cells)
+        fprintf(out, "%s,%d,%lld,%lld,%.6f,%lld,%.3f,%.3f\n", c.policy.c_str(), c.nframe, c.accesses,
+                c.faults, c.accesses ? (double)c.faults / c.accesses : 0.0, c.writebacks, c.stall_ms,
+                c.seconds);
+}
+
+inline void print_json(const std::vector<SweepCell>& cells, FILE* out = stdout) {
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < cells.size(); i++) {
+        const auto& c = cells[i];
+        fprintf(out, "  {\"policy\": \"%s\", \"frames\": %d, \"accesses\": %lld, \"faults\": %lld, "
+                     "\"miss_ratio\": %.6f, \"writebacks\": %lld, \"stall_ms\": %.3f, "
+                     "\"seconds\": %.3f}%s\n",
+                c.policy.c_str(), c.nframe, c.accesses, c.faults,
+                c.accesses ? (double)c.faults / c.accesses : 0.0, c.writebacks, c.stall_ms,
+                c.seconds, i + 1 < cells.size() ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
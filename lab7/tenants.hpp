@@ -0,0 +1,313 @@
+// 多租户：多个进程的访存交错成一个序列，共享同一个页框池
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "replacer.hpp"
+
+// 页号的高位放租户编号，不同租户的同一页号在页框池里是不同的页。
+// 租户自己的页号必须小于2^TENANT_SHIFT，否则会与别的页或别的租户混在一起
+constexpr int TENANT_SHIFT = 40;
+constexpr int MAX_TENANTS = 1 << (62 - TENANT_SHIFT);
+
+inline page tenant_page(int tenant, page p) { return static_cast<page>(tenant) << TENANT_SHIFT | p; }
+inline int tenant_of(page p) { return p >> TENANT_SHIFT; }
+
+struct TenantStats {
+    long long accesses = 0, faults = 0, writebacks = 0;
+    long long stolen = 0;   // 被其他租户的缺页换出的页数
+};
+
+// 按租户分别计数的sink，页号必须是tenant_page()的结果
+struct TenantSink {
+    vector<TenantStats> stats;
+    page victim = EMPTY_PAGE;  // 最近一次缺页换出的页，用于把写回记到页的主人头上
+
+    void access(page to) { stats[tenant_of(to)].accesses++; }
+    void fault(page v, page cur) {
+        victim = v;
+        stats[tenant_of(cur)].faults++;
+        if (v != EMPTY_PAGE && tenant_of(v) != tenant_of(cur)) stats[tenant_of(v)].stolen++;
+    }
+    void modify(page) {}
+    void report() {}
+};
+
+// 把各租户的访问交错成一个序列，Sources[i]是第i个租户的访问来源（TraceReader或Workload）
+// quantum > 0 时轮转调度，每个租户一次连续执行quantum次访问；
+// quantum == 0 时按各访问的时间戳（见TraceReader::stamp）归并，相同时编号小的租户在前。
+// 归并用败者树，每次取出最早的访问后只需沿一条路径比较log(租户数)次
+template<typename Sources>
+class TenantMix {
+    Sources& sources;
+    size_t quantum;
+
+    vector<int> active;     // 轮转中还有访问的租户
+    size_t turn = 0, used = 0;
+
+    // 排序键：时间戳在高64位，租户编号在低位，取完的租户为最大值。
+    // 合成一个整数后树上每层只有一次比较，可以编译成条件传送而不是分支
+    using key_t = unsigned __int128;
+    static constexpr key_t DONE = ~key_t(0);
+
+    int n;
+    vector<key_t> losers;           // 败者树，节点里直接存键，losers[0]为胜者，叶子t在位置n+t
+    vector<access_t> pending;       // 每个租户已读出、尚未轮到的那次访问
+
+    key_t load(int t) {
+        return sources[t].next(pending[t]) ? key_t(sources[t].stamp()) << 64 | t : DONE;
+    }
+
+public:
+    TenantMix(Sources& sources, size_t quantum) : sources(sources), quantum(quantum), n(sources.size()) {
+        if (quantum > 0) {
+            for (int t = 0; t < n; t++) active.push_back(t);
+            return;
+        }
+        pending.resize(n);
+        // 自底向上建树，winners[i]为以i为根的子树的胜者
+        losers.resize(n);
+        vector<key_t> winners(2 * n);
+        for (int t = 0; t < n; t++) winners[n + t] = load(t);
+        for (int i = n - 1; i > 0; i--) {
+            winners[i] = std::min(winners[2 * i], winners[2 * i + 1]);
+            losers[i] = std::max(winners[2 * i], winners[2 * i + 1]);
+        }
+        losers[0] = winners[n > 1 ? 1 : n];
+    }
+
+    bool next(int& tenant, access_t& a) {
+        if (quantum == 0) {
+            key_t w = losers[0];
+            if (w == DONE) return false;
+            tenant = static_cast<int>(w);
+            a = pending[tenant];
+            w = load(tenant);
+            for (int i = (n + tenant) / 2; i > 0; i /= 2) {
+                key_t l = losers[i];
+                losers[i] = std::max(l, w);
+                w = std::min(l, w);
+            }
+            losers[0] = w;
+            return true;
+        }
+        while (!active.empty()) {
+            if (used == quantum) {
+                used = 0;
+                turn = (turn + 1) % active.size();
+            }
+            tenant = active[turn];
+            if (sources[tenant].next(a)) {
+                used++;
+                return true;
+            }
+            active.erase(active.begin() + turn);
+            used = 0;
+            if (turn == active.size()) turn = 0;
+        }
+        return false;
+    }
+};
+
+// 逐次把交错后的访问交给access(tenant, page, status)，返回按租户计数的结果
+template<typename Mix, typename F>
+Status<TenantSink> drive_tenants(Mix& mix, int ntenant, int nframe, IoCost cost, F&& access) {
+    Status<TenantSink> status;
+    status.cost = cost;
+    status.start(nframe);
+    status.sink.stats.resize(ntenant);
+    int t;
+    access_t a;
+    while (mix.next(t, a)) {
+        if (a.pid >> TENANT_SHIFT) {
+            fprintf(stderr, "tenant %d: page %#llx does not fit in %d bits (use -s to convert addresses to pages)\n",
+                    t, static_cast<unsigned long long>(a.pid), TENANT_SHIFT);
+            exit(EXIT_FAILURE);
+        }
+        page p = tenant_page(t, a.pid);
+        long long writebacks = status.writebacks();
+        status.access(p, a.write);
+        access(t, p, status);
+        if (status.writebacks() != writebacks) status.sink.stats[tenant_of(status.sink.victim)].writebacks++;
+    }
+    return status;
+}
+
+// 全局置换：所有租户的页由同一个算法实例管理，缺页时可能换出任何租户的页
+template<typename Policy, typename Mix>
+Status<TenantSink> run_global(Mix& mix, int ntenant, int nframe, IoCost cost = {}) {
+    Policy policy(nframe);
+    return drive_tenants(mix, ntenant, nframe, cost, [&](int, page p, auto& status) {
+        policy.access(p, status);
+    });
+}
+
+// 固定分区的局部置换：页框平均分给各租户，每个租户一个算法实例，只换出自己的页
+// 要求 nframe >= ntenant
+template<typename Policy, typename Mix>
+Status<TenantSink> run_local(Mix& mix, int ntenant, int nframe, IoCost cost = {}) {
+    vector<Policy> policies;
+    policies.reserve(ntenant);
+    for (int t = 0; t < ntenant; t++) policies.emplace_back(nframe / ntenant + (t < nframe % ntenant));
+    return drive_tenants(mix, ntenant, nframe, cost, [&](int t, page p, auto& status) {
+        policies[t].access(p, status);
+    });
+}
+
+// 按工作集分配页框的局部置换：每window次访问为一个周期，周期结束时以各租户本周期内访问过的
+// 不同页数作为工作集大小，按max-min公平重新分配配额（工作集小的租户全部满足，其余平分剩下的页框）。
+// 缺页时租户没超配额就从超出配额的租户那里拿一个页框，否则换出自己的页；租户内部用LRU。
+// 只有驻留页记录访问周期，所以被换出后再次缺页的页会重复计数，频繁缺页的租户工作集偏大。
+// 第一个周期结束前没有配额限制
+class WorkingSetPool {
+    struct tenant_t {
+        int head = -1, tail = -1;    // 本租户驻留页的LRU链表，head为最近使用
+        int resident = 0;
+        int quota;
+        std::uint64_t distinct = 0;  // 本周期访问过的不同页数
+    };
+
+    int nframe;
+    std::uint64_t window;
+    FrameIndex index;
+    vector<page> pids;
+    vector<int> prev, next;
+    vector<std::uint64_t> epoch;      // 页框最近一次被访问的周期，0表示本页还没被访问过
+    vector<tenant_t> tenants;
+    vector<int> free_frames;
+    std::uint64_t now = 0, cur_epoch = 1;
+    size_t hand = 0;                   // 找超出配额的租户时轮转的位置
+    int n_over = 0;                    // 驻留页数超出配额的租户数，为0时不必轮转查找
+
+    void unlink(tenant_t& tn, int f) {
+        (prev[f] == -1 ? tn.head : next[prev[f]]) = next[f];
+        (next[f] == -1 ? tn.tail : prev[next[f]]) = prev[f];
+    }
+    void push_front(tenant_t& tn, int f) {
+        prev[f] = -1;
+        next[f] = tn.head;
+        (tn.head == -1 ? tn.tail : prev[tn.head]) = f;
+        tn.head = f;
+    }
+    void add_resident(tenant_t& tn, int delta) {
+        n_over -= tn.resident > tn.quota;
+        tn.resident += delta;
+        n_over += tn.resident > tn.quota;
+    }
+    void touch(tenant_t& tn, int f) {
+        if (epoch[f] == cur_epoch) return;
+        epoch[f] = cur_epoch;
+        tn.distinct++;
+    }
+    // 进入下一个周期，按工作集从小到大注水式分配
+    void roll() {
+        cur_epoch++;
+        vector<int> order(tenants.size());
+        for (size_t t = 0; t < order.size(); t++) order[t] = t;
+        std::sort(order.begin(), order.end(),
+                  [&](int a, int b) { return tenants[a].distinct < tenants[b].distinct; });
+        std::uint64_t left = nframe;
+        n_over = 0;
+        for (size_t k = 0; k < order.size(); k++) {
+            tenant_t& tn = tenants[order[k]];
+            std::uint64_t share = std::max<std::uint64_t>(left / (order.size() - k), 1);
+            tn.quota = std::min(std::max<std::uint64_t>(tn.distinct, 1), share);
+            left -= std::min<std::uint64_t>(tn.quota, left);
+            tn.distinct = 0;
+            n_over += tn.resident > tn.quota;
+        }
+    }
+
+    // 从hand开始轮转找一个满足条件的租户，找不到返回-1
+    template<typename Pred>
+    int find_tenant(Pred pred) {
+        for (size_t k = 0; k < tenants.size(); k++) {
+            int v = hand;
+            hand = (hand + 1) % tenants.size();
+            if (pred(tenants[v])) return v;
+        }
+        return -1;
+    }
+
+public:
+    WorkingSetPool(int ntenant, int nframe, std::uint64_t window)
+        : nframe(nframe), window(window), index(nframe), pids(nframe), prev(nframe), next(nframe),
+          epoch(nframe), tenants(ntenant, { .quota = nframe }) {
+        for (int f = nframe; f-- > 0;) free_frames.push_back(f);
+    }
+
+    int quota(int t) const { return tenants[t].quota; }
+    int resident(int t) const { return tenants[t].resident; }
+
+    template<typename S>
+    void access(int t, page p, S& status) {
+        if (++now % window == 0) roll();
+        tenant_t& tn = tenants[t];
+        if (int f = index.find(p); f != -1) {
+            touch(tn, f);
+            unlink(tn, f);
+            push_front(tn, f);
+            return;
+        }
+
+        int f;
+        if (!free_frames.empty()) {
+            f = free_frames.back();
+            free_frames.pop_back();
+            status.fault();
+        } else {
+            // 没用满配额时先从超出配额的租户那里拿，没有这样的租户就换出自己的页
+            int v = -1;
+            if (tn.resident < tn.quota && n_over > 0)
+                v = find_tenant([](const tenant_t& x) { return x.resident > x.quota; });
+            if (v == -1) v = tn.resident > 0 ? t : find_tenant([](const tenant_t& x) { return x.resident > 0; });
+            tenant_t& victim = tenants[v];
+            f = victim.tail;
+            unlink(victim, f);
+            add_resident(victim, -1);
+            index.erase(pids[f]);
+            status.fault(pids[f]);
+        }
+        pids[f] = p;
+        epoch[f] = 0;
+        index.insert(p, f);
+        push_front(tn, f);
+        add_resident(tn, 1);
+        touch(tn, f);
+    }
+};
+
+inline Status<TenantSink> run_working_set(auto& mix, int ntenant, int nframe, std::uint64_t window,
+                                          IoCost cost = {}) {
+    WorkingSetPool pool(ntenant, nframe, window);
+    return drive_tenants(mix, ntenant, nframe, cost, [&](int t, page p, auto& status) {
+        pool.access(t, p, status);
+    });
+}
+
+// 每个租户一行，最后一行all为合计
+inline void print_tenants(const Status<TenantSink>& status, FILE* out = stdout) {
+    auto row = [&](const char* name, const TenantStats& s) {
+        fprintf(out, "%s,%lld,%lld,%.6f,%lld,%lld,%.3f\n", name, s.accesses, s.faults,
+                s.accesses ? (double)s.faults / s.accesses : 0.0, s.writebacks, s.stolen,
+                (s.faults * status.cost.read_us + s.writebacks * status.cost.write_us) / 1000);
+    };
+    fprintf(out, "tenant,accesses,faults,miss_ratio,writebacks,stolen,stall_ms\n");
+    TenantStats all;
+    char name[24];
+    for (size_t t = 0; t < status.sink.stats.size(); t++) {
+        const auto& s = status.sink.stats[t];
+        snprintf(name, sizeof(name), "%zu", t);
+        row(name, s);
+        all.accesses += s.accesses;
+        all.faults += s.faults;
+        all.writebacks += s.writebacks;
+        all.stolen += s.stolen;
+    }
+    row("all", all);
+}
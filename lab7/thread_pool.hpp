@@ -0,0 +1,58 @@
+// 一批互相独立的任务在多个线程上并行执行
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取：任务先轮流分到每个线程自己的双端队列，线程从自己队列的尾部取任务，
+// 自己的做完了就从其他线程队列的头部偷。任务执行时不会产生新任务，
+// 所以所有队列都空了就说明这一批做完了
+inline void parallel_run(std::vector<std::function<void()>> tasks, unsigned nthread = 0) {
+    if (nthread == 0) nthread = std::max(1u, std::thread::hardware_concurrency());
+    nthread = std::min<unsigned>(nthread, std::max<size_t>(tasks.size(), 1));
+
+    struct queue_t {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+    std::vector<std::unique_ptr<queue_t>> queues;
+    for (unsigned i = 0; i < nthread; i++) queues.push_back(std::make_unique<queue_t>());
+    for (size_t i = 0; i < tasks.size(); i++) queues[i % nthread]->tasks.push_back(std::move(tasks[i]));
+
+    auto worker = [&](unsigned self) {
+        std::function<void()> task;
+        while (true) {
+            bool found = false;
+            {
+                auto& q = *queues[self];
+                std::lock_guard lock(q.m);
+                if (!q.tasks.empty()) {
+                    task = std::move(q.tasks.back());
+                    q.tasks.pop_back();
+                    found = true;
+                }
+            }
+            for (unsigned k = 1; !found && k < nthread; k++) {
+                auto& q = *queues[(self + k) % nthread];
+                std::lock_guard lock(q.m);
+                if (!q.tasks.empty()) {
+                    task = std::move(q.tasks.front());
+                    q.tasks.pop_front();
+                    found = true;
+                }
+            }
+            if (!found) return;
+            task();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < nthread; i++) threads.emplace_back(worker, i);
+    worker(0);
+    for (auto& t : threads) t.join();
+}
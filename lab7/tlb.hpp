@@ -0,0 +1,143 @@
+// 页大小与TLB：虚拟地址按页大小切成页号，先查两级组相联TLB，再交给页框置换
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "replacer.hpp"
+
+// 组相联、组内LRU的查找表。组数为2的幂，用页号低位选组；每组路数不多，组内线性查找
+class SetAssoc {
+    size_t ways, mask;
+    std::vector<page> tags;                // 第s组占 [s*ways, (s+1)*ways)
+    std::vector<std::uint64_t> last_use;   // 各路最近一次使用的时间，用于组内LRU
+    std::uint64_t clock = 0;
+
+public:
+    // entries/ways必须是2的幂
+    SetAssoc(size_t entries, size_t ways)
+        : ways(ways), mask(entries / ways - 1), tags(entries, EMPTY_PAGE), last_use(entries) {}
+
+    // 命中返回true；未命中时换掉组内最久未用的一路
+    bool access(page key) {
+        size_t base = (static_cast<std::uint64_t>(key) & mask) * ways;
+        size_t victim = base;
+        clock++;
+        for (size_t i = base; i < base + ways; i++) {
+            if (tags[i] == key) {
+                last_use[i] = clock;
+                return true;
+            }
+            if (last_use[i] < last_use[victim]) victim = i;
+        }
+        tags[victim] = key;
+        last_use[victim] = clock;
+        return false;
+    }
+
+    void invalidate(page key) {
+        size_t base = (static_cast<std::uint64_t>(key) & mask) * ways;
+        for (size_t i = base; i < base + ways; i++) {
+            if (tags[i] == key) {
+                tags[i] = EMPTY_PAGE;
+                last_use[i] = 0;
+            }
+        }
+    }
+};
+
+// 默认值参考常见的x86实现：L1 4K页64项4路、大页32项4路，L2 1536项12路
+struct TlbConfig {
+    size_t l1_entries = 64, l1_ways = 4;
+    size_t l1_huge_entries = 32, l1_huge_ways = 4;  // 页大于4K时L1用这一组参数
+    size_t l2_entries = 1536, l2_ways = 12;
+    double l2_cycles = 7;     // L1未命中、L2命中的代价
+    double walk_cycles = 30;  // L2也未命中，走一遍页表的代价
+
+    bool valid() const {
+        auto ok = [](size_t entries, size_t ways) {
+            size_t sets = ways ? entries / ways : 0;
+            return sets > 0 && sets * ways == entries && (sets & (sets - 1)) == 0;
+        };
+        return ok(l1_entries, l1_ways) && ok(l1_huge_entries, l1_huge_ways) && ok(l2_entries, l2_ways);
+    }
+};
+
+class Tlb {
+    SetAssoc l1, l2;
+    long long n_access = 0, n_l1_miss = 0, n_walk = 0;
+
+public:
+    Tlb(const TlbConfig& cfg, bool huge)
+        : l1(huge ? cfg.l1_huge_entries : cfg.l1_entries, huge ? cfg.l1_huge_ways : cfg.l1_ways),
+          l2(cfg.l2_entries, cfg.l2_ways) {}
+
+    // 一次地址转换，L2命中的项同时装入L1
+    void access(page vpn) {
+        n_access++;
+        if (l1.access(vpn)) return;
+        n_l1_miss++;
+        if (!l2.access(vpn)) n_walk++;
+    }
+    // 页被换出时对应的TLB项失效
+    void invalidate(page vpn) {
+        l1.invalidate(vpn);
+        l2.invalidate(vpn);
+    }
+
+    long long accesses() const { return n_access; }
+    long long l1_misses() const { return n_l1_miss; }
+    long long walks() const { return n_walk; }
+};
+
+// 缺页换出时让TLB里的旧项失效（TLB shootdown）
+struct TlbSink {
+    Tlb* tlb;
+
+    void access(page) {}
+    void fault(page victim, page) {
+        if (victim != EMPTY_PAGE) tlb->invalidate(victim);
+    }
+    void modify(page) {}
+    void report() {}
+};
+
+struct TlbResult {
+    int page_shift;
+    int nframe;
+    long long accesses, l1_misses, walks, faults, writebacks;
+    double cycles;            // 地址转换的估算总周期数（TLB命中不计）
+};
+
+// 序列里是虚拟地址，按2^page_shift字节一页切成页号后先过TLB，再交给置换算法
+template<typename Policy, typename Seq>
+TlbResult simulate_tlb(Seq& seq, int page_shift, int nframe, const TlbConfig& cfg) {
+    Tlb tlb(cfg, page_shift > 12);
+    Status<TlbSink> status;
+    status.sink.tlb = &tlb;
+    status.start(nframe);
+    Policy policy(nframe);
+    for (auto a : seq) {
+        auto [addr, write] = to_access(a);
+        page vpn = static_cast<page>(static_cast<std::uint64_t>(addr) >> page_shift);
+        tlb.access(vpn);
+        status.access(vpn, write);
+        policy.access(vpn, status);
+    }
+    return {
+        page_shift, nframe, tlb.accesses(), tlb.l1_misses(), tlb.walks(), status.faults(), status.writebacks(),
+        (tlb.l1_misses() - tlb.walks()) * cfg.l2_cycles + tlb.walks() * cfg.walk_cycles,
+    };
+}
+
+inline void print_tlb(const std::vector<TlbResult>& results, const TlbConfig& cfg, FILE* out = stdout) {
+    fprintf(out, "page_kb,frames,accesses,l1_misses,l1_miss_ratio,walks,walk_ratio,l2_reach_kb,"
+                 "faults,writebacks,translation_cycles_per_access\n");
+    for (const auto& r : results) {
+        double n = r.accesses ? r.accesses : 1;
+        fprintf(out, "%lld,%d,%lld,%lld,%.6f,%lld,%.6f,%lld,%lld,%lld,%.3f\n", 1ll << r.page_shift >> 10,
+                r.nframe, r.accesses, r.l1_misses, r.l1_misses / n, r.walks, r.walks / n,
+                (long long)cfg.l2_entries << r.page_shift >> 10, r.faults, r.writebacks, r.cycles / n);
+    }
+}
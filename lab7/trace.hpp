@@ -0,0 +1,236 @@
+// 访存序列（trace）的流式读取
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 页号用64位，真实地址右移12位后仍可能超过int的范围
+using page = std::int64_t;
+constexpr page EMPTY_PAGE = -1;
+
+// 一次访存：页号和是否为写操作
+struct access_t {
+    page pid;
+    bool write = false;
+};
+
+// 序列里可以直接放页号（视为读），也可以放access_t
+inline access_t to_access(page p) { return { p, false }; }
+inline access_t to_access(access_t a) { return a; }
+
+enum class TraceFormat {
+    text,   // 每行一次访问：[时间戳:] [操作] 地址[,大小]，兼容valgrind lackey / perf mem的文本输出
+            // 操作为S/M/W时是写，I/L/R或省略时是读；时间戳只在多租户交错时使用
+    binary, // 每次访问一个本机字节序的uint64，最高位为1表示写
+};
+
+// 分块读取trace文件，任何时候内存中只有一块，与trace长度无关
+// 每次begin()都会回到文件开头，因此同一个reader可以被多个算法依次重放
+class TraceReader {
+public:
+    static constexpr size_t CHUNK = 1 << 16;  // 默认每块的访问数
+private:
+    static constexpr size_t TEXT_BYTES = 16;  // 文本格式每次read的字节数为每块访问数的这么多倍
+    static constexpr std::uint64_t WRITE_BIT = 1ull << 63;
+    static constexpr std::uint64_t NO_STAMP = ~0ull;
+
+    int fd;
+    const char* path;
+    TraceFormat format;
+    int page_shift;          // 地址 -> 页号的右移位数，0表示trace里已经是页号
+    size_t chunk;            // 每块的访问数
+    bool started = false;    // 是否已经读过数据，stdin这种无法回绕的只能读一遍
+    bool eof = false;
+
+    std::vector<access_t> buf;          // 当前块的访问
+    std::vector<std::uint64_t> stamps;  // 与buf对应的时间戳，没有时为NO_STAMP，二进制格式为空
+    std::uint64_t ordinal = 0;          // 已经返回的访问数
+    std::vector<std::uint64_t> raw;     // 二进制格式的原始记录
+    size_t pos = 0;
+    std::vector<char> text;  // 文本格式的原始字节，末尾可能残留半行
+    size_t text_len = 0;
+
+    static bool is_hex(char c) {
+        return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+    }
+
+    // 解析一行，成功返回true。lackey带操作符的行地址是不带0x的十六进制，
+    // 纯数字行则按strtoull的规则（0x开头为十六进制，否则十进制）
+    bool parse_line(const char* s, const char* e, std::uint64_t& value, bool& write,
+                    std::uint64_t& stamp) const {
+        while (s < e && (*s == ' ' || *s == '\t')) s++;
+        if (s == e || *s == '#' || *s == '=') return false;
+        // 开头的十进制数后面紧跟':'时是时间戳
+        stamp = NO_STAMP;
+        const char* t = s;
+        std::uint64_t ts = 0;
+        for (; t < e && *t >= '0' && *t <= '9'; t++) ts = ts * 10 + (*t - '0');
+        if (t != s && t < e && *t == ':') {
+            stamp = ts;
+            for (s = t + 1; s < e && (*s == ' ' || *s == '\t');) s++;
+        }
+        int base = 10;
+        write = false;
+        if (e - s > 1 && strchr("ILSMRW", *s) && (s[1] == ' ' || s[1] == '\t')) {
+            write = *s == 'S' || *s == 'M' || *s == 'W';
+            s += 2;
+            while (s < e && (*s == ' ' || *s == '\t')) s++;
+            base = 16;
+        }
+        if (e - s > 2 && s[0] == '0' && (s[1] | 0x20) == 'x') {
+            s += 2;
+            base = 16;
+        }
+        std::uint64_t v = 0;
+        const char* digits = s;
+        if (base == 16) {
+            for (; s < e && is_hex(*s); s++)
+                v = v * 16 + (*s <= '9' ? *s - '0' : (*s | 0x20) - 'a' + 10);
+        } else {
+            for (; s < e && *s >= '0' && *s <= '9'; s++)
+                v = v * 10 + (*s - '0');
+        }
+        if (s == digits) return false;
+        value = v;
+        return true;
+    }
+
+    // 把底层read读满，返回读到的字节数
+    size_t read_full(char* dst, size_t size) {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = read(fd, dst + done, size - done);
+            if (n == -1) {
+                perror(path);
+                exit(EXIT_FAILURE);
+            }
+            if (n == 0) {
+                eof = true;
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    bool refill_binary() {
+        raw.resize(chunk);
+        size_t n = read_full(reinterpret_cast<char*>(raw.data()), chunk * sizeof(std::uint64_t))
+            / sizeof(std::uint64_t); // 结尾不足8字节的残片直接丢弃
+        buf.resize(n);
+        for (size_t i = 0; i < n; i++)
+            buf[i] = { static_cast<page>((raw[i] & ~WRITE_BIT) >> page_shift), (raw[i] & WRITE_BIT) != 0 };
+        return n > 0;
+    }
+
+    bool refill_text() {
+        buf.clear();
+        stamps.clear();
+        while (buf.empty()) {
+            if (eof && text_len == 0) return false;
+            if (!eof) text_len += read_full(text.data() + text_len, text.size() - text_len);
+
+            // 只解析完整的行，残留的半行挪到开头等下次read补全
+            // 到了文件末尾或者一行比整个缓冲区还长时，剩下的也当作一行
+            size_t end = text_len;
+            if (!eof) {
+                while (end > 0 && text[end - 1] != '\n') end--;
+                if (end == 0) end = text_len;
+            }
+            const char* s = text.data();
+            for (const char* e; s < text.data() + end; s = e + 1) {
+                e = static_cast<const char*>(memchr(s, '\n', text.data() + end - s));
+                if (!e) e = text.data() + end;
+                std::uint64_t v, stamp;
+                bool write;
+                if (parse_line(s, e, v, write, stamp)) {
+                    buf.push_back({ static_cast<page>(v >> page_shift), write });
+                    stamps.push_back(stamp);
+                }
+            }
+            memmove(text.data(), text.data() + end, text_len - end);
+            text_len -= end;
+        }
+        return true;
+    }
+
+    bool refill() {
+        pos = 0;
+        started = true;
+        return format == TraceFormat::binary ? refill_binary() : refill_text();
+    }
+
+public:
+    // path为"-"时读标准输入。同时打开很多trace（例如多租户）时把chunk调小，
+    // 每个reader的缓冲区约为chunk * 16字节
+    TraceReader(const char* path, TraceFormat format = TraceFormat::text, int page_shift = 0, size_t chunk = CHUNK)
+        : path(path), format(format), page_shift(page_shift), chunk(chunk) {
+        fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+        if (fd == -1) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        buf.reserve(chunk);
+        if (format == TraceFormat::text) text.resize(chunk * TEXT_BYTES);
+    }
+    ~TraceReader() {
+        if (fd != STDIN_FILENO) close(fd);
+    }
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    // 回到trace开头
+    void rewind() {
+        if (started && lseek(fd, 0, SEEK_SET) == -1) {
+            fprintf(stderr, "%s: trace cannot be replayed (not seekable)\n", path);
+            exit(EXIT_FAILURE);
+        }
+        started = eof = false;
+        buf.clear();
+        stamps.clear();
+        pos = text_len = 0;
+        ordinal = 0;
+    }
+
+    bool next(access_t& a) {
+        if (pos == buf.size() && !refill()) return false;
+        a = buf[pos++];
+        ordinal++;
+        return true;
+    }
+
+    // 上一次next()返回的访问的时间戳，trace中没有时间戳时为它是第几次访问（从0开始）
+    std::uint64_t stamp() const {
+        return pos <= stamps.size() && stamps[pos - 1] != NO_STAMP ? stamps[pos - 1] : ordinal - 1;
+    }
+
+    struct iterator {
+        using value_type = access_t;
+        using difference_type = std::ptrdiff_t;
+
+        TraceReader* reader;
+        access_t cur;
+
+        access_t operator*() const { return cur; }
+        iterator& operator++() {
+            if (!reader->next(cur)) reader = nullptr;
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return !reader; }
+    };
+
+    iterator begin() {
+        rewind();
+        iterator it { this, { EMPTY_PAGE } };
+        return ++it;
+    }
+    std::default_sentinel_t end() const { return {}; }
+};
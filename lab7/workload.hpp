@@ -0,0 +1,370 @@
+// 合成负载：按模型惰性生成访存序列，可以代替trace驱动所有算法
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+
+// xoshiro256**，比mt19937快得多，状态由splitmix64从种子展开
+class Rng {
+    std::uint64_t s[4];
+
+    static std::uint64_t rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit Rng(std::uint64_t seed = 1) {
+        for (auto& x : s) {
+            std::uint64_t z = (seed += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            x = z ^ (z >> 31);
+        }
+    }
+
+    std::uint64_t next() {
+        std::uint64_t r = rotl(s[1] * 5, 7) * 9;
+        std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return r;
+    }
+
+    // [0, n)，乘法取高位代替取模（Lemire），偏差在2^-64量级
+    std::uint64_t below(std::uint64_t n) { return (unsigned __int128)next() * n >> 64; }
+    // [0, 1)
+    double uniform() { return (next() >> 11) * 0x1.0p-53; }
+};
+
+// Zipf分布，返回[0, n)，0最热门，P(k) ∝ 1/(k+1)^s
+// n不大时用别名表（Vose），每次采样一个随机数加一次查表；
+// n太大放不下表时用rejection-inversion（Hörmann & Derflinger），O(1)不需要额外内存
+class Zipf {
+    static constexpr std::uint64_t ALIAS_MAX = 1 << 22;
+
+    // 第i列以prob/2^32的概率取i，否则取alias；两者放在一起，一次采样只碰一个缓存行
+    struct column {
+        std::uint32_t prob, alias;
+    };
+
+    std::uint64_t n;
+    double s;
+    std::vector<column> table;
+    double h_x1, h_n, squeeze;
+
+    // log(1+x)/x 和 (e^x-1)/x，x接近0时用泰勒展开避免相消
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+    }
+    double h(double x) const { return std::exp(-s * std::log(x)); }
+    double h_integral(double x) const {
+        double lx = std::log(x);
+        return helper2((1 - s) * lx) * lx;
+    }
+    double h_integral_inverse(double x) const {
+        double t = std::max(x * (1 - s), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+
+    std::uint64_t slot(std::uint64_t x) const { return (x >> 32) * n >> 32; }
+    std::uint64_t pick(std::uint64_t x) const {
+        const column& c = table[slot(x)];
+        return static_cast<std::uint32_t>(x) < c.prob ? slot(x) : c.alias;
+    }
+
+public:
+    Zipf(std::uint64_t n, double s) : n(n), s(s) {
+        if (n <= ALIAS_MAX) {
+            std::vector<double> p(n);
+            double sum = 0;
+            for (std::uint64_t k = 0; k < n; k++) sum += p[k] = std::pow(k + 1.0, -s);
+            std::vector<std::uint32_t> small, large;
+            for (std::uint64_t k = 0; k < n; k++) {
+                p[k] *= n / sum;
+                (p[k] < 1 ? small : large).push_back(k);
+            }
+            table.resize(n);
+            for (std::uint64_t k = 0; k < n; k++)  // 剩下的满列指向自己
+                table[k] = { UINT32_MAX, static_cast<std::uint32_t>(k) };
+            while (!small.empty() && !large.empty()) {
+                std::uint32_t l = small.back(), g = large.back();
+                small.pop_back();
+                large.pop_back();
+                table[l] = { static_cast<std::uint32_t>(p[l] * 4294967296.0), g };
+                p[g] += p[l] - 1;
+                (p[g] < 1 ? small : large).push_back(g);
+            }
+        } else {
+            h_x1 = h_integral(1.5) - 1;
+            h_n = h_integral(n + 0.5);
+            squeeze = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+        }
+    }
+
+    std::uint64_t operator()(Rng& rng) const {
+        if (!table.empty()) return pick(rng.next());
+        while (true) {
+            double u = h_n + rng.uniform() * (h_x1 - h_n);
+            double x = h_integral_inverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1) k = 1;
+            else if (k > n) k = n;
+            if (k - x <= squeeze || u >= h_integral(k + 0.5) - h(k))
+                return static_cast<std::uint64_t>(k) - 1;
+        }
+    }
+
+    // 成批采样，结果加上base写入out[i].pid。表比缓存大时先算出所有列号并预取，再逐个查表
+    void fill(Rng& rng, access_t* out, size_t k, page base) const {
+        if (table.empty()) {
+            for (size_t j = 0; j < k; j++) out[j].pid = base + (*this)(rng);
+            return;
+        }
+        constexpr size_t BLOCK = 64;
+        std::uint64_t x[BLOCK];
+        for (size_t j = 0; j < k; j += BLOCK) {
+            size_t m = std::min(BLOCK, k - j);
+            for (size_t i = 0; i < m; i++) {
+                x[i] = rng.next();
+                __builtin_prefetch(&table[slot(x[i])]);
+            }
+            for (size_t i = 0; i < m; i++) out[j + i].pid = base + pick(x[i]);
+        }
+    }
+};
+
+// 负载的一个阶段，页号都从base开始
+struct Phase {
+    enum class Kind {
+        uniform, // [0, pages) 均匀随机
+        zipf,    // [0, pages) 上参数为s的Zipf
+        shift,   // 大小为pages的工作集内均匀随机，每period次访问工作集整体后移step页
+        scan,    // 顺序访问，页号一直递增，不会重复
+        loop,    // 在[0, pages)上顺序循环
+    } kind;
+    std::uint64_t len = 1 << 20;    // 每轮中本阶段的访问数
+    page base = 0;
+    std::uint64_t pages = 1 << 16;
+    double s = 0.99;
+    std::uint64_t period = 1 << 16;
+    std::uint64_t step = 0;         // 0表示等于pages，即工作集整个换掉
+    double write = 0;               // 写操作的比例
+
+    // 生成过程中的状态，每次begin()清零
+    std::uint64_t t = 0;            // 本阶段已经生成的访问数（跨轮累计）
+};
+
+// 按顺序轮流执行各阶段，直到总共生成total次访问
+// 用法与TraceReader相同，每次begin()都用同一个种子重新开始，所以多个算法看到的是同一个序列
+class Workload {
+    static constexpr size_t BATCH = 1 << 12;
+
+    std::vector<Phase> phases;
+    // 与phases一一对应，非zipf阶段为空表。别名表可能很大，拷贝出的负载共用同一份
+    std::shared_ptr<const std::vector<Zipf>> zipfs;
+    std::uint64_t total, seed;
+    size_t batch = BATCH;
+
+    Rng rng;
+    Rng write_rng;                      // 读写标志单独一个流，页号序列和读写都与batch无关
+    size_t cur = 0;                     // 当前阶段
+    std::uint64_t in_phase = 0;         // 当前阶段本轮已生成的访问数
+    std::uint64_t done = 0;
+    std::vector<access_t> buf;
+    size_t pos = 0;
+
+    // 由当前阶段生成k次访问，k不超过本轮剩余的长度
+    void generate(access_t* out, size_t k) {
+        Phase& ph = phases[cur];
+        switch (ph.kind) {
+        case Phase::Kind::uniform:
+            for (size_t j = 0; j < k; j++) out[j].pid = ph.base + rng.below(ph.pages);
+            break;
+        case Phase::Kind::zipf:
+            (*zipfs)[cur].fill(rng, out, k, ph.base);
+            break;
+        case Phase::Kind::shift: {
+            std::uint64_t step = ph.step ? ph.step : ph.pages;
+            for (size_t j = 0; j < k; j++)
+                out[j].pid = ph.base + (ph.t + j) / ph.period * step + rng.below(ph.pages);
+            break;
+        }
+        case Phase::Kind::scan:
+            for (size_t j = 0; j < k; j++) out[j].pid = ph.base + ph.t + j;
+            break;
+        case Phase::Kind::loop: {
+            std::uint64_t x = ph.t % ph.pages;
+            for (size_t j = 0; j < k; j++) {
+                out[j].pid = ph.base + x;
+                if (++x == ph.pages) x = 0;
+            }
+            break;
+        }
+        }
+        ph.t += k;
+
+        if (ph.write <= 0) {
+            for (size_t j = 0; j < k; j++) out[j].write = false;
+        } else if (ph.write >= 1) {
+            for (size_t j = 0; j < k; j++) out[j].write = true;
+        } else {
+            std::uint64_t threshold = ph.write * 18446744073709551616.0;
+            for (size_t j = 0; j < k; j++) out[j].write = write_rng.next() < threshold;
+        }
+    }
+
+    bool refill() {
+        pos = 0;
+        buf.resize(std::min<std::uint64_t>(batch, total - done));
+        for (size_t n = 0; n < buf.size();) {
+            if (in_phase == phases[cur].len) {
+                cur = (cur + 1) % phases.size();
+                in_phase = 0;
+            }
+            size_t k = std::min<std::uint64_t>(buf.size() - n, phases[cur].len - in_phase);
+            generate(buf.data() + n, k);
+            n += k;
+            in_phase += k;
+        }
+        done += buf.size();
+        return !buf.empty();
+    }
+
+public:
+    // total为0时跑完一轮所有阶段
+    Workload(std::vector<Phase> phases, std::uint64_t total = 0, std::uint64_t seed = 1)
+        : phases(std::move(phases)), total(total), seed(seed) {
+        if (this->total == 0)
+            for (const auto& ph : this->phases) this->total += ph.len;
+        std::vector<Zipf> tables;
+        for (const auto& ph : this->phases)
+            tables.emplace_back(ph.kind == Phase::Kind::zipf ? ph.pages : 0, ph.s);
+        zipfs = std::make_shared<const std::vector<Zipf>>(std::move(tables));
+        rewind();
+    }
+
+    // 同样的阶段换一个种子，zipf的表共用。batch为每次生成的访问数，
+    // 同时存在大量负载（例如多租户）时调小以节省内存
+    Workload with_seed(std::uint64_t seed, size_t batch = BATCH) const {
+        Workload w = *this;
+        w.seed = seed;
+        w.batch = batch;
+        w.rewind();
+        return w;
+    }
+
+    std::uint64_t size() const { return total; }
+
+    void rewind() {
+        rng = Rng(seed);
+        write_rng = Rng(~seed);
+        for (auto& ph : phases) ph.t = 0;
+        cur = pos = 0;
+        in_phase = done = 0;
+        buf.clear();
+    }
+
+    bool next(access_t& a) {
+        if (pos == buf.size() && !refill()) return false;
+        a = buf[pos++];
+        return true;
+    }
+
+    // 上一次next()返回的是第几次访问（从0开始），合成负载没有真实的时间戳
+    std::uint64_t stamp() const { return done - buf.size() + pos - 1; }
+
+    struct iterator {
+        using value_type = access_t;
+        using difference_type = std::ptrdiff_t;
+
+        Workload* workload;
+        access_t cur;
+
+        access_t operator*() const { return cur; }
+        iterator& operator++() {
+            if (!workload->next(cur)) workload = nullptr;
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return !workload; }
+    };
+
+    iterator begin() {
+        rewind();
+        iterator it { this, { EMPTY_PAGE } };
+        return ++it;
+    }
+    std::default_sentinel_t end() const { return {}; }
+};
+
+// 解析负载描述，各阶段以'+'分隔，每个阶段为 模型[:键=值,...]，例如
+//   zipf:pages=1e5,s=0.8,len=1e6,w=0.3+scan:len=2e5,base=1e6
+// 模型：uniform zipf shift scan loop
+// 键：len base pages s period step w，含义见Phase，数值可以写成1e6
+inline bool parse_workload(const char* spec, std::vector<Phase>& phases) {
+    static constexpr const char* KINDS[] = { "uniform", "zipf", "shift", "scan", "loop" };
+    phases.clear();
+    for (const char* e; *spec; spec = *e ? e + 1 : e) {
+        e = strchrnul(spec, '+');
+        std::string item(spec, e);
+        size_t colon = item.find(':');
+        std::string kind = item.substr(0, colon);
+
+        Phase ph { Phase::Kind::uniform };
+        size_t k = 0;
+        while (k < std::size(KINDS) && kind != KINDS[k]) k++;
+        if (k == std::size(KINDS)) {
+            fprintf(stderr, "unknown workload model: %s\n", kind.c_str());
+            return false;
+        }
+        ph.kind = static_cast<Phase::Kind>(k);
+
+        std::string args = colon == std::string::npos ? "" : item.substr(colon + 1);
+        for (char* kv = strtok(args.data(), ","); kv; kv = strtok(nullptr, ",")) {
+            char* eq = strchr(kv, '=');
+            char* end = nullptr;
+            double v = eq ? strtod(eq + 1, &end) : 0;
+            if (!eq || end == eq + 1 || *end || v < 0) {
+                fprintf(stderr, "bad workload parameter: %s\n", kv);
+                return false;
+            }
+            *eq = '\0';
+            if (!strcmp(kv, "len")) ph.len = v;
+            else if (!strcmp(kv, "base")) ph.base = v;
+            else if (!strcmp(kv, "pages")) ph.pages = v;
+            else if (!strcmp(kv, "s")) ph.s = v;
+            else if (!strcmp(kv, "period")) ph.period = v;
+            else if (!strcmp(kv, "step")) ph.step = v;
+            else if (!strcmp(kv, "w")) ph.write = v;
+            else {
+                fprintf(stderr, "unknown workload parameter: %s\n", kv);
+                return false;
+            }
+        }
+        if (ph.len == 0 || ph.pages == 0 || ph.period == 0) {
+            fprintf(stderr, "len, pages and period must be positive: %s\n", item.c_str());
+            return false;
+        }
+        phases.push_back(ph);
+    }
+    if (phases.empty()) {
+        fprintf(stderr, "empty workload\n");
+        return false;
+    }
+    return true;
+}